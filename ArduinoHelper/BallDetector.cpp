@@ -0,0 +1,85 @@
+#include "BallDetector.h"
+#include "Detector.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+using namespace cv;
+
+/** Find balls.
+@param mask - thresholded picture, 8-bit, 0 or 255.
+@param balls - balls found
+*/
+void HoughBallDetector::detect(const Mat &mask, vector<Ball> &balls){
+    /// Hough Circles transform - check OpenCV documentation.
+    vector<Vec3f> circlesFound;
+    HoughCircles(mask, circlesFound, HOUGH_GRADIENT, 1, mask.rows / distanceDivisor, canny, votes, minimumRadius, maximumRadius);
+
+    for (size_t i = 0; i < circlesFound.size(); i++){
+        Ball ball = {Point2f(circlesFound[i][0], circlesFound[i][1]), circlesFound[i][2]};
+        balls.push_back(ball);
+    }
+}
+
+/** Take Hough's parameters.
+@param params - parameters
+*/
+void HoughBallDetector::paramsSet(const DetectorParams &params){
+    canny = params.houghCanny;
+    distanceDivisor = max(1, params.houghDistanceDivisor);
+    maximumRadius = params.houghMaximumRadius;
+    minimumRadius = params.houghMinimumRadius;
+    votes = params.houghVotes;
+}
+
+/** Take the contour algorithm's parameters.
+@param params - parameters
+*/
+void ContourBallDetector::paramsSet(const DetectorParams &params){
+    distanceDivisor = max(1, params.contourDistanceDivisor);
+    minimumCircularity = params.contourCircularity;
+    minimumFill = params.contourFill;
+    minimumRadius = params.contourMinimumRadius;
+}
+
+/** Find balls.
+@param mask - thresholded picture, 8-bit, 0 or 255.
+@param balls - balls found
+*/
+void ContourBallDetector::detect(const Mat &mask, vector<Ball> &balls){
+    const float minimumDistance = mask.rows / distanceDivisor; /// Between 2 balls' centres
+
+    mask.copyTo(workspace);
+    findContours(workspace, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+
+    /// Score each blob.
+    vector<pair<double, Ball> > candidates;
+    for (size_t i = 0; i < contours.size(); i++){
+        double area = contourArea(contours[i]);
+        if (area < M_PI * minimumRadius * minimumRadius * minimumFill)
+            continue; /// Too small, no need to check further.
+
+        Ball ball;
+        minEnclosingCircle(contours[i], ball.centre, ball.radius);
+        if (ball.radius < minimumRadius)
+            continue;
+
+        double perimeter = arcLength(contours[i], true);
+        double circularity = 4 * M_PI * area / (perimeter * perimeter);
+        double fill = area / (M_PI * ball.radius * ball.radius);
+        if (circularity >= minimumCircularity && fill >= minimumFill)
+            candidates.push_back(make_pair(circularity * fill, ball));
+    }
+
+    /// Best first, skipping the ones too near to a better one.
+    sort(candidates.begin(), candidates.end(), [](const pair<double, Ball> &a, const pair<double, Ball> &b){ return a.first > b.first;});
+    size_t firstNew = balls.size();
+    for (size_t i = 0; i < candidates.size(); i++){
+        const Ball &candidate = candidates[i].second;
+        bool isolated = true;
+        for (size_t j = firstNew; j < balls.size() && isolated; j++)
+            isolated = hypot(balls[j].centre.x - candidate.centre.x, balls[j].centre.y - candidate.centre.y) >= minimumDistance;
+        if (isolated)
+            balls.push_back(candidate);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef BALLDETECTOR_H_INCLUDED
+#define BALLDETECTOR_H_INCLUDED
+#include "DetectorParams.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <vector>
+
+using namespace cv;
+
+struct Ball;
+
+/** Finds balls in a thresholded picture (ball's color separated). Implementations can be exchanged at runtime.
+*/
+class BallDetector{
+    public:
+        virtual ~BallDetector(){}
+
+        /** Find balls.
+        @param mask - thresholded picture, 8-bit, 0 or 255.
+        @param balls - balls found
+        */
+        virtual void detect(const Mat &mask, std::vector<Ball> &balls) = 0;
+
+        /** Name, for reports.
+        @return - name
+        */
+        virtual const char *name() = 0;
+};
+
+/** Hough Circles transform. Robust with partly hidden balls, but slow and sensitive to parameters.
+*/
+class HoughBallDetector : public BallDetector{
+    public:
+        /** Find balls.
+        @param mask - thresholded picture, 8-bit, 0 or 255.
+        @param balls - balls found
+        */
+        void detect(const Mat &mask, std::vector<Ball> &balls);
+
+        /** Name, for reports.
+        @return - name
+        */
+        const char *name(){ return "Hough";}
+
+        /** Take Hough's parameters.
+        @param params - parameters
+        */
+        void paramsSet(const DetectorParams &params);
+
+    private:
+        int canny = 100; /// Canny's upper threshold
+        int distanceDivisor = 3; /// Minimum distance between balls is picture's height divided by this.
+        int maximumRadius = 0; /// Biggest ball, 0 for no limit.
+        int minimumRadius = 20; /// Smallest ball
+        int votes = 20; /// Accumulator threshold
+};
+
+/** Blobs in the mask are scored by circularity (4*pi*area/perimeter^2) and fill ratio (area/enclosing circle's area). Many times faster than
+Hough on binary masks.
+*/
+class ContourBallDetector : public BallDetector{
+    public:
+        /** Find balls.
+        @param mask - thresholded picture, 8-bit, 0 or 255.
+        @param balls - balls found
+        */
+        void detect(const Mat &mask, std::vector<Ball> &balls);
+
+        /** Name, for reports.
+        @return - name
+        */
+        const char *name(){ return "Contour";}
+
+        /** Take the contour algorithm's parameters.
+        @param params - parameters
+        */
+        void paramsSet(const DetectorParams &params);
+
+    private:
+        std::vector<std::vector<Point> > contours; /// Blobs' outlines
+        int distanceDivisor = 3; /// Minimum distance between balls is picture's height divided by this.
+        double minimumCircularity = 0.7; /// 1 for a perfect circle
+        double minimumFill = 0.6; /// 1 for a perfect circle
+        float minimumRadius = 20; /// Smallest ball
+        Mat workspace; /// Mask's copy, as findContours may change it.
+};
+
+#endif // BALLDETECTOR_H_INCLUDED
@@ -0,0 +1,233 @@
+#include "BinaryMask.h"
+#include <algorithm>
+#include <math.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+/** Bitwise AND of 2 rows, 2 words at once if NEON is available.
+@param destination - result and the first operand.
+@param source - the second operand.
+@param count - number of words.
+*/
+static inline void andWords(uint64_t *destination, const uint64_t *source, int count){
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 2 <= count; i += 2)
+        vst1q_u64(destination + i, vandq_u64(vld1q_u64(destination + i), vld1q_u64(source + i)));
+#endif
+    for (; i < count; i++)
+        destination[i] &= source[i];
+}
+
+/** Bitwise OR of 2 rows, 2 words at once if NEON is available.
+@param destination - result and the first operand.
+@param source - the second operand.
+@param count - number of words.
+*/
+static inline void orWords(uint64_t *destination, const uint64_t *source, int count){
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 2 <= count; i += 2)
+        vst1q_u64(destination + i, vorrq_u64(vld1q_u64(destination + i), vld1q_u64(source + i)));
+#endif
+    for (; i < count; i++)
+        destination[i] |= source[i];
+}
+
+/** Constructor
+@param rows - height
+@param cols - width
+*/
+BinaryMask::BinaryMask(int rows, int cols){
+    create(rows, cols);
+}
+
+/** Clear bits beyond the last column in every row.
+*/
+void BinaryMask::clearPadding(){
+    if (cols % 64 == 0)
+        return;
+    uint64_t keep = (1ULL << (cols % 64)) - 1;
+    for (int y = 0; y < rows; y++)
+        bits[y * words + words - 1] &= keep;
+}
+
+/** Allocate. Content is cleared.
+@param rows - height
+@param cols - width
+*/
+void BinaryMask::create(int rowsNow, int colsNow){
+    rows = rowsNow;
+    cols = colsNow;
+    words = (cols + 63) / 64;
+    bits.assign(rows * words, 0);
+}
+
+/** Dilation with an elliptic structuring element, same result as OpenCV's dilate() with getStructuringElement(MORPH_ELLIPSE, kernel).
+@param kernel - structuring element's size, odd numbers.
+*/
+void BinaryMask::dilate(Size kernel){
+    morphology(kernel, false);
+}
+
+/** Erosion with an elliptic structuring element, same result as OpenCV's erode() with getStructuringElement(MORPH_ELLIPSE, kernel).
+@param kernel - structuring element's size, odd numbers.
+*/
+void BinaryMask::erode(Size kernel){
+    morphology(kernel, true);
+}
+
+/** Copy from a Mat. Nonzero pixels are set.
+@param mask - 8-bit, 1 channel.
+*/
+void BinaryMask::fromMat(const Mat &mask){
+    create(mask.rows, mask.cols);
+    for (int y = 0; y < rows; y++){
+        const uint8_t *pixel = mask.ptr<uint8_t>(y);
+        uint64_t *row = &bits[y * words];
+        for (int x = 0; x < cols; x++)
+            if (pixel[x])
+                row[x >> 6] |= 1ULL << (x & 63);
+    }
+}
+
+/** Separate a color, like OpenCV's inRange(), directly into bits.
+@param image - 8-bit, 3 channels.
+@param low - lower limits, inclusive.
+@param high - upper limits, inclusive.
+*/
+void BinaryMask::inRange(const Mat &image, const Scalar &low, const Scalar &high){
+    create(image.rows, image.cols);
+    const int channels = image.channels();
+    int lowLimit[3], highLimit[3];
+    for (int c = 0; c < 3; c++){
+        lowLimit[c] = (int)ceil(low[c]);
+        highLimit[c] = (int)floor(high[c]);
+    }
+
+    for (int y = 0; y < rows; y++){
+        const uint8_t *pixel = image.ptr<uint8_t>(y);
+        uint64_t *row = &bits[y * words];
+        for (int w = 0; w < words; w++){
+            uint64_t word = 0;
+            int end = min(64, cols - w * 64);
+            for (int b = 0; b < end; b++, pixel += channels){
+                bool in = pixel[0] >= lowLimit[0] && pixel[0] <= highLimit[0];
+                if (channels == 3)
+                    in = in && pixel[1] >= lowLimit[1] && pixel[1] <= highLimit[1] && pixel[2] >= lowLimit[2] && pixel[2] <= highLimit[2];
+                word |= (uint64_t)in << b;
+            }
+            row[w] = word;
+        }
+    }
+}
+
+/** Erosion or dilation. OpenCV's default border is used: for erosion pixels outside are set, for dilation they are not.
+@param kernel - structuring element's size, odd numbers.
+@param isErosion - erosion, otherwise dilation.
+*/
+void BinaryMask::morphology(Size kernel, bool isErosion){
+    const uint64_t fill = isErosion ? ~0ULL : 0;
+    const int r = kernel.height / 2;
+    const int c = kernel.width / 2;
+
+    /// Structuring element, as in OpenCV's getStructuringElement(MORPH_ELLIPSE): half width of each row.
+    halfWidths.resize(kernel.height);
+    vector<int> distinct;
+    double inverseR2 = r ? 1.0 / ((double)r * r) : 0;
+    for (int i = 0; i < kernel.height; i++){
+        int dy = i - r;
+        halfWidths[i] = (int)lrint(c * sqrt((r * r - dy * dy) * inverseR2));
+        if (find(distinct.begin(), distinct.end(), halfWidths[i]) == distinct.end())
+            distinct.push_back(halfWidths[i]);
+    }
+
+    /// Horizontal pass, once for each distinct half width.
+    horizontal.resize(distinct.size() * rows * words);
+    padded.resize(words + 2);
+    for (int y = 0; y < rows; y++){
+        padded[0] = fill;
+        copy(&bits[y * words], &bits[y * words] + words, &padded[1]);
+        padded[words + 1] = fill;
+        if (cols % 64 != 0 && isErosion)
+            padded[words] |= ~((1ULL << (cols % 64)) - 1);
+
+        for (size_t d = 0; d < distinct.size(); d++){
+            int h = distinct[d];
+            uint64_t *out = &horizontal[(d * rows + y) * words];
+            for (int w = 0; w < words; w++){
+                uint64_t value = padded[w + 1];
+                for (int k = 1; k <= h; k++){
+                    uint64_t right = (padded[w + 1] >> k) | (padded[w + 2] << (64 - k)); /// Pixel x + k
+                    uint64_t left = (padded[w + 1] << k) | (padded[w] >> (64 - k)); /// Pixel x - k
+                    value = isErosion ? (value & right & left) : (value | right | left);
+                }
+                out[w] = value;
+            }
+        }
+    }
+
+    /// Vertical pass. Rows outside the mask do not change the result.
+    result.resize(rows * words);
+    for (int y = 0; y < rows; y++){
+        uint64_t *out = &result[y * words];
+        fill_n(out, words, fill);
+        for (int i = 0; i < kernel.height; i++){
+            int source = y + i - r;
+            if (source < 0 || source >= rows)
+                continue;
+            size_t d = find(distinct.begin(), distinct.end(), halfWidths[i]) - distinct.begin();
+            const uint64_t *in = &horizontal[(d * rows + source) * words];
+            if (isErosion)
+                andWords(out, in, words);
+            else
+                orWords(out, in, words);
+        }
+    }
+
+    bits.swap(result);
+    clearPadding();
+}
+
+/** Erosion followed by dilation: removes small islands.
+@param kernel - structuring element's size, odd numbers.
+*/
+void BinaryMask::open(Size kernel){
+    morphology(kernel, true);
+    morphology(kernel, false);
+}
+
+/** Copy to a Mat: 255 for set pixels, 0 for others.
+@param mask - 8-bit, 1 channel. Allocated if needed.
+*/
+void BinaryMask::toMat(Mat &mask) const{
+    mask.create(rows, cols, CV_8UC1);
+    for (int y = 0; y < rows; y++){
+        uint8_t *pixel = mask.ptr<uint8_t>(y);
+        const uint64_t *row = &bits[y * words];
+        for (int x = 0; x < cols; x++)
+            pixel[x] = ((row[x >> 6] >> (x & 63)) & 1) ? 255 : 0;
+    }
+}
+
+/** Union
+@param other - same size.
+@return - this mask.
+*/
+BinaryMask &BinaryMask::operator|=(const BinaryMask &other){
+    orWords(bits.data(), other.bits.data(), (int)bits.size());
+    return *this;
+}
+
+/** Intersection
+@param other - same size.
+@return - this mask.
+*/
+BinaryMask &BinaryMask::operator&=(const BinaryMask &other){
+    andWords(bits.data(), other.bits.data(), (int)bits.size());
+    return *this;
+}
@@ -0,0 +1,109 @@
+#ifndef BINARYMASK_H_INCLUDED
+#define BINARYMASK_H_INCLUDED
+#include <opencv2/imgproc/imgproc.hpp>
+#include <stdint.h>
+#include <vector>
+
+using namespace cv;
+
+/** Black and white picture, one bit per pixel. Morphology and logical operations work on 64 pixels at once. Convert to and from Mat only when
+an OpenCV function needs it (contours, Hough, display).
+*/
+class BinaryMask{
+    public:
+        /** Constructor
+        @param rows - height
+        @param cols - width
+        */
+        BinaryMask(int rows = 0, int cols = 0);
+
+        /** Allocate. Content is cleared.
+        @param rows - height
+        @param cols - width
+        */
+        void create(int rows, int cols);
+
+        /** Dilation with an elliptic structuring element, same result as OpenCV's dilate() with getStructuringElement(MORPH_ELLIPSE, kernel).
+        @param kernel - structuring element's size, odd numbers.
+        */
+        void dilate(Size kernel = Size(5, 5));
+
+        /** Erosion with an elliptic structuring element, same result as OpenCV's erode() with getStructuringElement(MORPH_ELLIPSE, kernel).
+        @param kernel - structuring element's size, odd numbers.
+        */
+        void erode(Size kernel = Size(5, 5));
+
+        /** Copy from a Mat. Nonzero pixels are set.
+        @param mask - 8-bit, 1 channel.
+        */
+        void fromMat(const Mat &mask);
+
+        /** Pixel
+        @param x - column
+        @param y - row
+        @return - set. Pixels outside the mask are not set.
+        */
+        bool get(int x, int y) const{
+            if (x < 0 || y < 0 || x >= cols || y >= rows)
+                return false;
+            return (bits[y * words + (x >> 6)] >> (x & 63)) & 1;
+        }
+
+        /** Separate a color, like OpenCV's inRange(), directly into bits.
+        @param image - 8-bit, 3 channels.
+        @param low - lower limits, inclusive.
+        @param high - upper limits, inclusive.
+        */
+        void inRange(const Mat &image, const Scalar &low, const Scalar &high);
+
+        /** Erosion followed by dilation: removes small islands.
+        @param kernel - structuring element's size, odd numbers.
+        */
+        void open(Size kernel = Size(5, 5));
+
+        /** A row's words. Pixel x is bit x % 64 of word x / 64.
+        @param y - row
+        @return - words
+        */
+        const uint64_t *row(int y) const{ return &bits[y * words];}
+
+        /** Copy to a Mat: 255 for set pixels, 0 for others.
+        @param mask - 8-bit, 1 channel. Allocated if needed.
+        */
+        void toMat(Mat &mask) const;
+
+        /** Union
+        @param other - same size.
+        @return - this mask.
+        */
+        BinaryMask &operator|=(const BinaryMask &other);
+
+        /** Intersection
+        @param other - same size.
+        @return - this mask.
+        */
+        BinaryMask &operator&=(const BinaryMask &other);
+
+        int cols = 0; /// Width
+        int rows = 0; /// Height
+
+    private:
+        std::vector<uint64_t> bits; /// Pixels, row by row. Each row starts with a new word. Bits beyond cols are always 0.
+        std::vector<uint64_t> horizontal; /// Workspace: rows processed horizontally
+        std::vector<int> halfWidths; /// Workspace: structuring element's rows
+        std::vector<uint64_t> padded; /// Workspace: one row with a word more on each side
+        std::vector<uint64_t> result; /// Workspace: morphology result
+        int words = 0; /// 64-bit words in a row
+
+        /** Clear bits beyond the last column in every row.
+        */
+        void clearPadding();
+
+        /** Erosion or dilation.
+        @param kernel - structuring element's size, odd numbers.
+        @param isErosion - erosion, otherwise dilation.
+        */
+        void morphology(Size kernel, bool isErosion);
+};
+
+#endif // BINARYMASK_H_INCLUDED
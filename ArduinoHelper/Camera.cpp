@@ -1,6 +1,9 @@
 #include "Camera.h"
+#include "FrameScheduler.h"
+#include "Metrics.h"
+#include "Regression.h"
+#include "SharedBus.h"
 #include <ctime>
-#include <dirent.h>
 #include <iostream>
 #include <math.h>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -16,14 +19,17 @@ using namespace cv;
 /** Constructor
 @param runtType - chosen program's behavior.
 @param thresh - Canny threshold.
-@param saveImages - save images to disk.
+@param saveImages - save images to disk, for Regression. YUV pictures are stored as 1-channel PNGs named *.yuv.png.
+@param format - picture format.
 */
-Camera::Camera(int threshold, bool saveImagesNow){
+Camera::Camera(int threshold, bool saveImagesNow, CaptureFormat formatNow) : detector(threshold){
     pRaspiCam = new raspicam::RaspiCam_Cv();// Sprema se pointer koji pokazuje na kameru. Pomoću njega se kasnije uvijek poziva ova kamera.
+    format = formatNow;
     thresh = threshold;
     saveImages = saveImagesNow;
     lastCameraMs = 0;
     startMs = 0;
+    grabbing = false;
 
     cout << "Camera..." << flush;
 
@@ -33,9 +39,28 @@ Camera::Camera(int threshold, bool saveImagesNow){
     pRaspiCam->set(CV_CAP_PROP_FRAME_WIDTH, HIGH_RES ? 1920 : 160);//320, 160
     pRaspiCam->set(CV_CAP_PROP_FRAME_HEIGHT, HIGH_RES ? 1080 : 120);//240, 120
 
+    /// Tuned parameters replace the defaults.
+    if (detector.profileLoad())
+        cout << "profile loaded...";
+
+    /// Floor-plane calibration, tables are computed once for the cropped part.
+    Size frame(HIGH_RES ? 1920 : 160, HIGH_RES ? 1080 : 120);
+    if (floorMap.load(FLOOR_CALIBRATION, Detector::crop(frame))){
+        detector.floorMapSet(&floorMap);
+        cout << "floor calibrated...";
+    }
+
+    /// YUV: planes as the sensor pipeline delivers them, no color conversion.
+    if (format == CAPTURE_YUV420){
+        pRaspiCamYuv = new raspicam::RaspiCam();
+        pRaspiCamYuv->setFormat(raspicam::RASPICAM_FORMAT_YUV420);
+        pRaspiCamYuv->setWidth(frame.width);
+        pRaspiCamYuv->setHeight(frame.height);
+    }
+
     /// Start the camera
     cout << "opening...";
-    if (!pRaspiCam->open())
+    if (format == CAPTURE_YUV420 ? !pRaspiCamYuv->open() : !pRaspiCam->open())
         cerr<<"Error opening the camera"<<endl;
 
     cout << "OK" << endl;
@@ -45,11 +70,27 @@ Camera::Camera(int threshold, bool saveImagesNow){
 */
 Camera::~Camera(){
     cout << "Stop camera..." << endl;
-    pRaspiCam->release();
+    grabStop();
+    if (pRaspiCamYuv != 0)
+        pRaspiCamYuv->release();
+    else
+        pRaspiCam->release();
+}
+
+/** Picture in BGR format.
+@param image - picture as captured
+@return - the same picture or, in YUV format, its converted copy.
+*/
+const Mat &Camera::bgr(const Mat &image){
+    if (format != CAPTURE_YUV420)
+        return image;
+    cvtColor(image, bgrImage, COLOR_YUV2BGR_I420);
+    return bgrImage;
 }
 
 /** Find HSV parameters to maximize number of found circles. Warning: this is no desired result for finding a single ball. To calibrate a sinle ball,
 a viable solution would be to put the ball in a predefined position and then find the values that yield only a single, biggest shape.
+Robot::TUNE_DETECTOR optimizes accuracy and speed over a labelled corpus instead.
 */
 void Camera::calibrateBall(){
 
@@ -57,7 +98,7 @@ void Camera::calibrateBall(){
 
     int circleCount;
     int maxCircleCount = -1;
-    int extremeLow, extremeHigh;
+    int extremeLow = 0, extremeHigh = 0;
 
     for (int low = 0; low <= 255; low += 10){
         for (int high = low + 10; high <= 255; high += 10){
@@ -70,128 +111,153 @@ void Camera::calibrateBall(){
             cout << low << "-" << high << ": " << circleCount << endl;
         }
     }
-
+    cout << "Most circles: " << maxCircleCount << ", V " << extremeLow << "-" << extremeHigh << endl;
 }
 
 /** Camera captures one image.
 */
 void Camera::capture(){
     if ((millis() - lastCameraMs)  > 30 ){/// 33 FPS
-        pRaspiCam->grab(); /// Take a picture
-        pRaspiCam->retrieve(srcImage); /// Copy it to srcImage
+        shoot(srcImage); /// Take a picture
+        if (saveImages)
+            save(srcImage);
 
         lastCameraMs = millis();
     }
 }
 
 /** Detect a geen marker in RoboCup Line crossing.
-@param display - display picture by picture. A key must be pressed to advance. Otherwise a continuous flow with FPS indicated.
+@param display - show pictures in a separate thread, without slowing down processing. Key 'q' or Esc ends the program.
 */
 void Camera::crossing(bool display){
 
-    ///Change these values to detech green only:
-    uint8_t lowH = 40;
-    uint8_t highH = 80;
-    uint8_t lowS = 00;
-    uint8_t highS = 255;
-    uint8_t lowV = 40;
-    uint8_t highV = 120;
-
     waitForCapture();
-    Mat imgHSV;
+    grabStart();
+    FrameScheduler scheduler;
+    int stageCrossing = scheduler.stageAdd("crossing", false);
+    int stageDisplay = scheduler.stageAdd("display", true);
+    Detections detections;
+    Mat image;
+    uint32_t captureMs;
+    uint32_t lastReportMs = millis();
     startMs = millis();
     cnt = 0;
 
+    detector.changeDetectionEnable(true); /// Static scenes: reuse the previous detections while nothing changes.
+    if (display)
+        viewer.start();
+
+    int32_t lastMarker = MARKER_NONE;
     while(true){
 
-        capture();
+        /// The newest frame only, too old ones are dropped.
+        if (!newest(image, captureMs) || !scheduler.frameBegin(captureMs))
+            continue;
 
-        /// Crop the picture, remove upper part.
-        uint16_t yStart = srcImage.rows * 0.35;
-        Rect roi(0, yStart, srcImage.cols, srcImage.rows - yStart);
-        srcImage = srcImage(roi);
+        bool displayNow = display && scheduler.stageAllowed(stageDisplay);
+        detector.overlayEnable(displayNow);
+        if (format == CAPTURE_YUV420)
+            detector.crossingYuv(image, detections);
+        else
+            detector.crossing(image, detections);
+        scheduler.stageDone(stageCrossing, detections.ms);
+
+        /// Printed only when it changes, the metrics show it live.
+        Metrics::set(METRIC_MARKER, detections.marker);
+        if (detections.marker != lastMarker){
+            if (detections.marker == MARKER_RIGHT)
+                cout << "Right marker" << endl;
+            else if (detections.marker == MARKER_LEFT)
+                cout << "Left marker" << endl;
+            lastMarker = detections.marker;
+        }
 
-        /// Change colorspace to HSV (hue, saturation, value).
-        cvtColor(srcImage, imgHSV, COLOR_BGR2HSV);
+        /// Hand over all the windows to the viewer, unless it is still busy with the previous ones.
+        if (displayNow){
+            uint32_t displayStartUs = micros();
+            if (viewer.quitRequested())
+                exit(0);
+            if (viewer.ready()){
+                Mat imgThresholdBlack;
+                detector.thresholdBlack().toMat(imgThresholdBlack);
+                viewer.add("Original", detector.roi(), 500, 35, detections.overlay); /// Original image
+                viewer.add("ThresholdedGreen", detector.thresholdGreen(), 500, 540); /// Green part
+                viewer.add("ThresholdedBlack", imgThresholdBlack, 1100, 35); /// Black part
+                viewer.add("ThresholdedBoth", imgThresholdBlack | detector.thresholdGreen(), 1100, 540); /// Green and black parts
+                if (floorMap.valid()){
+                    Mat floor;
+                    floorMap.warp(detector.roi(), floor);
+                    viewer.add("Floor", floor, 1700, 35); /// Bird's-eye view
+                }
+                viewer.publish();
+            }
+            scheduler.stageDone(stageDisplay, (micros() - displayStartUs) / 1000.0);
+        }
+        scheduler.frameEnd();
 
-        /// Separate the green part.
-        Mat imgThresholdGreen;
-        inRange(imgHSV, Scalar(lowH, lowS, lowV), Scalar(highH, highS, highV), imgThresholdGreen);
+        fps(); /// Count FPS
+        if (millis() - lastReportMs > 10000){
+            scheduler.report();
+            lastReportMs = millis();
+        }
+    }
+}
+
+/** Run all the detectors on the newest frame, in parallel on all the cores. Frames too old are dropped and optional stages (balls,
+display) skipped if they do not fit into the frame's time budget.
+@param balls - detect balls too.
+@param display - show pictures in a separate thread, without slowing down processing. Key 'q' or Esc ends the program.
+*/
+void Camera::detectAll(bool balls, bool display){
+
+    waitForCapture();
+    grabStart();
+    ThreadPool pool;
+    FrameScheduler scheduler;
+    int stageDetect = scheduler.stageAdd("detect", false);
+    int stageBalls = scheduler.stageAdd("balls", true, stageDetect); /// Runs on the pool, alongside detect's own tasks.
+    int stageDisplay = scheduler.stageAdd("display", true);
+    Detections detections;
+    Mat image;
+    uint32_t captureMs;
+    uint32_t lastReportMs = millis();
+    startMs = millis();
+    cnt = 0;
 
-        /// Erode and dilate the image to delete small islands inside and outside.
-        erode(imgThresholdGreen, imgThresholdGreen, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
-        dilate(imgThresholdGreen, imgThresholdGreen, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
+    if (display)
+        viewer.start();
 
-        /// Separata black parts.
-        Mat imgThresholdBlack;
-        inRange(imgHSV, Scalar(0, 0, 0), Scalar(179, 255, 50), imgThresholdBlack);
+    while(true){
 
-        /// Canny - find edges
-        Mat canny_output;//Izlazna matrica
-        vector<vector<Point> > contours;//Sve konture
-        vector<Vec4i> hierarchy;
-        Canny( imgThresholdGreen, canny_output, thresh, thresh*2, 3 );
+        if (!newest(image, captureMs) || !scheduler.frameBegin(captureMs))
+            continue;
 
-        /// Find (all) contours
-        findContours(canny_output, contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0) );
+        bool ballsNow = balls && scheduler.stageAllowed(stageBalls);
+        bool displayNow = display && scheduler.stageAllowed(stageDisplay);
+        detector.overlayEnable(displayNow);
 
-        /// Check every countour
-        for( uint16_t i = 0; i< contours.size(); i++ ) //Po svi konturama slike.
-        {
-            /// Calculate moments: center of gravity and area
-            Moments oMoments = moments(contours[i]);
-            double dM01 = oMoments.m01;
-            double dM10 = oMoments.m10;
-            double area = oMoments.m00;
-            int cX = dM10 / area; /// Gravity centre's x
-            int cY = dM01 / area; /// y
-
-            /// If area is big enough, it can be a marker
-            if (area > srcImage.cols * srcImage.rows /8000){
-
-                /// Write some text to label the marker
-                putText(srcImage, "Marker", Point(cX - 10, cY), FONT_HERSHEY_COMPLEX_SMALL, 0.8, Scalar(0, 255, 0), 0.6, CV_AA);
-
-                /// Draw this contour (in green).
-                drawContours(srcImage, contours, i, Scalar(0, 255, 0), 2, 8, hierarchy, 0, Point() );
-
-                /// Draw 3 red circles, designating the black-check areas.
-                uint8_t dX = srcImage.cols * 0.16;
-                uint8_t dY = srcImage.rows * 0.28;
-                circle(srcImage, Point(cX - dX, cY), 2, Scalar(0, 0, 255));
-                circle(srcImage, Point(cX + dX, cY), 2, Scalar(0, 0, 255));
-                circle(srcImage, Point(cX, cY - dY), 2, Scalar(0, 0, 255));
-
-                if (imgThresholdBlack.at<uint8_t>(Point(cX, cY - dY)) == 255) /// If point above is black, this can be a marker
-                    if (imgThresholdBlack.at<uint8_t>(Point(cX - dX, cY)) == 255){ /// if the one to the left is also black, this is a right marker.
-                        cout << "Right marker" << endl;
-                        break;
-                    }
-                    else if (imgThresholdBlack.at<uint8_t>(Point(cX + dX, cY)) == 255){/// if the one to the right is also black, this is a left marker.
-                        cout << "Left marker" << endl;
-                        break;
-                    }
+        detector.detectAll(bgr(image), pool, ballsNow, detections);
+        scheduler.stageDone(stageDetect, detections.ms);
+        if (ballsNow)
+            scheduler.stageDone(stageBalls, detections.ballsMs);
+
+        if (displayNow){
+            uint32_t displayStartUs = micros();
+            if (viewer.quitRequested())
+                exit(0);
+            if (viewer.ready()){
+                viewer.add("Original", bgr(image), 500, 35, detections.overlay);
+                viewer.publish();
             }
+            scheduler.stageDone(stageDisplay, (micros() - displayStartUs) / 1000.0);
         }
+        scheduler.frameEnd();
 
-        /// Display all thw windows
-        if (display){
-            imshow("Original", srcImage); /// Original image
-            moveWindow("Original", 500, 35);
-            imshow("ThresholdedGreen", imgThresholdGreen); /// Green part
-            moveWindow("ThresholdedGreen", 500, 540);
-            imshow("ThresholdedBlack", imgThresholdBlack); /// Black part
-            moveWindow("ThresholdedBlack", 1100, 35);
-            imshow("ThresholdedBoth", imgThresholdBlack | imgThresholdGreen); /// Green and black parts
-            moveWindow("ThresholdedBoth", 1100, 540);
-
-            /// Wait for a key. If Esc, exit the program.
-            uint8_t ch = waitKey(0);
-            if (ch == 'q' || ch == 27)//esc
-                exit(0);
+        fps(); /// Count FPS
+        if (millis() - lastReportMs > 10000){
+            scheduler.report();
+            lastReportMs = millis();
         }
-        else
-            fps(); /// Display FPS
     }
 }
 
@@ -213,23 +279,20 @@ void Camera::findCirclesUsingTrackbars(int lowH, int highH, int lowS, int highS,
     if (lowV == -1) lowV = 60;
     if (highV == -1) highV = 147;
 
-    /// Window for trackbars
-    namedWindow("Control", WINDOW_AUTOSIZE);
+    /// Add trackbars to "Control" window.
+    int lowHBar = viewer.trackbarAdd("LowH", lowH, 179);
+    int highHBar = viewer.trackbarAdd("HighH", highH, 179);
+    int lowSBar = viewer.trackbarAdd("LowS", lowS, 255);
+    int highSBar = viewer.trackbarAdd("HighS", highS, 255);
+    int lowVBar = viewer.trackbarAdd("LowV", lowV, 255);
+    int highVBar = viewer.trackbarAdd("HighV", highV, 255);
 
-    /// Add trackbars to the window above.
-    createTrackbar("LowH", "Control", &lowH, 179);
-    createTrackbar("HighH", "Control", &highH, 179);
-    createTrackbar("LowS", "Control", &lowS, 255);
-    createTrackbar("HighS", "Control", &highS, 255);
-    createTrackbar("LowV", "Control", &lowV, 255);
-    createTrackbar("HighV", "Control", &highV, 255);
-
-    /// Continuously capture pictures and find circles. After each step, You can alter HSV parameters.
+    /// Continuously capture pictures and find circles, until 'q', Esc or a closed window. After each step, You can alter HSV parameters.
     int circleCount;
-    for (int i = 0; i < 1000; i++){
+    while (!viewer.quitRequested()){
         capture();
-        cout << "Frame " << i << " captured" << endl;
-        findCircles(lowH, highH, lowS, highS, lowV, highV, true, circleCount);
+        findCircles(viewer.trackbar(lowHBar), viewer.trackbar(highHBar), viewer.trackbar(lowSBar), viewer.trackbar(highSBar),
+            viewer.trackbar(lowVBar), viewer.trackbar(highVBar), true, circleCount);
     }
 }
 
@@ -240,121 +303,154 @@ void Camera::findCirclesUsingTrackbars(int lowH, int highH, int lowS, int highS,
 @param highS - hSv upper limit
 @param lowV - hsV lower limit
 @param highV - hsV upper limit
-@param display - break and show results for each image
+@param display - show results in a separate thread. Key 'q' or Esc ends the program.
 @param circleCount - number of circles found.
 */
 void Camera::findCircles(int lowH, int highH, int lowS, int highS, int lowV, int highV,  bool display, int &numberOfCircles){
 
-    /// Limits:
-    if (highH > 179) highH = 179;
-    if (highS > 255) highS = 255;
-    if (highV > 255) highV = 255;
-
     if (srcImage.empty())
         return;
 
-    /// Convert image to HSV space (hue, saturation, value).
-    Mat imgHSV;
-    cvtColor(srcImage, imgHSV, COLOR_BGR2HSV);
+    Detections detections;
+    detector.overlayEnable(display);
+    detector.circles(bgr(srcImage), lowH, highH, lowS, highS, lowV, highV, detections);
+    numberOfCircles = detections.balls.size();
 
-    /// 2 structures to hod images with separated colors (thresholded).
-    Mat imgThresholded;
-    Mat imgThresholded2;
-
-    /// Separate colors
-    if(lowH > highH) /// A more complicated case when end and beginning part of H is requested.
-    {
-        inRange(imgHSV, Scalar(0, lowS, lowV), Scalar(highH, highS, highV), imgThresholded);
-        inRange(imgHSV, Scalar(lowH, lowS, lowV), Scalar(179, highS, highV), imgThresholded2);
-        imgThresholded = imgThresholded + imgThresholded2;
-    }
-    else
-        inRange(imgHSV, Scalar(lowH, lowS, lowV), Scalar(highH, highS, highV), imgThresholded);
-
-    /// Remove small islands.
-    erode(imgThresholded, imgThresholded, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
-    dilate(imgThresholded, imgThresholded, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
-
-    /// Hough Circles transform - check OpenCV documentation.
-    vector<Vec3f> circles;
-    HoughCircles(imgThresholded, circles, HOUGH_GRADIENT, 1,
-                 imgThresholded.rows/3,  // change this value to detect circles with different distances to each other
-                 100, 20, 20, 0 // change the last two parameters
-            // (min_radius & max_radius) to detect larger circles
-    );
-    numberOfCircles = circles.size();
-
-    /// Display all the circles
+    /// Hand over all the windows to the viewer, unless it is still busy with the previous ones.
     if (display){
-        for( size_t i = 0; i < circles.size(); i++ )
-        {
-            Vec3i c = circles[i];
-            Point center = Point(c[0], c[1]);
-
-            /// Draw centre on the source image.
-            circle( srcImage, center, 1, Scalar(0,100,100), 3, LINE_AA);
-
-            /// Draw circular outline
-            int radius = c[2];
-            circle( srcImage, center, radius, Scalar(255,0,255), 3, LINE_AA);
-        }
-
-        /// Display all the windows
-        imshow("Original", srcImage); /// Original image
-        moveWindow("Original", 500, 35);
-        imshow("Thresholded", imgThresholded); /// Thresholded
-        moveWindow("Thresholded", 500, 540);
-
-        /// Wait for a key. If Esc, exit the program.
-        uint8_t ch = waitKey(0);
-        if (ch == 'q' || ch == 27)//esc
+        viewer.start();
+        if (viewer.quitRequested())
             exit(0);
-       //imshow("Thresholded2", imgThresholded + imgThresholoded2);
+        if (viewer.ready()){
+            viewer.add("Original", bgr(srcImage), 500, 35, detections.overlay); /// Original image, circles drawn
+            viewer.add("Thresholded", detector.thresholdCircles(), 500, 540); /// Thresholded
+            viewer.publish();
+        }
     }
 }
 
-/** Frames Per Second
+/** Frames Per Second: count a processed frame and update the FPS gauge, served by the metrics instead of printed.
 */
 void Camera::fps(){
     cnt++;
-    if (millis() - lastFpsDisplayMs > 10000) {//Svakih 10 sec ispis FPSa, broja slika u sekundi.
-		cout << endl << cnt << " image in " << ((millis() - startMs)/1000) << " sec: "<< (round(cnt / ((millis() - startMs) / 1000.0))) << " FPS." << endl;
-        lastFpsDisplayMs = millis();
-	}
+    Metrics::add(METRIC_FRAMES_PROCESSED);
+    uint32_t elapsedMs = millis() - startMs;
+    if (elapsedMs > 0)
+        Metrics::set(METRIC_FPS, cnt * 1000ull / elapsedMs);
 }
 
 
+/** Capture continuously and publish each frame once to shared memory, for other processes (vision worker, logger...).
+*/
+void Camera::serve(){
+    FrameBus bus;
+    if (!bus.create())
+        exit(13);
+
+    waitForCapture();
+    startMs = millis();
+    cnt = 0;
+    uint32_t lastPublishedMs = 0;
+    while (true){
+        capture();
+        if (lastCameraMs != lastPublishedMs){ /// A new picture
+            bus.publish(bgr(srcImage), lastCameraMs);
+            lastPublishedMs = lastCameraMs;
+            fps();
+        }
+        else
+            delay(1);
+    }
+}
+
 /** A way of testing program with not live images. Instead, read images from disk. Record a few hunders images and run this test each time You change the
-program to be sure the change didn't break something.
+program to be sure the change didn't break something. The first run stores golden results, the next ones report changed detections and speed.
 */
 void Camera::unitTest(){
-    const bool verbose = false;
-    DIR *dir;
-    struct dirent *ent;
-    if ((dir = opendir ("/home/pi/images/")) != NULL) {/// Check directory's existence. You can use some other path.
-
-        RNG rng(12345); /// Random generator
-
-        /// Print all the files and directories within directory.
-        while ((ent = readdir (dir)) != NULL) {
-            cout << ent->d_name << endl; /// Files' name.
-
-            String imgName = (String)"/home/pi/images/" + ent->d_name;
-            srcImage = imread(imgName.c_str(), IMREAD_COLOR);   /// Read the image
-            if(!srcImage.data) /// It must not be empty.
-            {
-                cout <<  "Could not open or find the image" << std::endl ;
-                return;
-            }
+    Regression regression("/home/pi/images/", thresh); /// You can use some other path.
+    regression.run();
+}
 
-            /// The missing part here is Your test.
+/** Grabber thread's loop.
+*/
+void Camera::grab(){
+    Mat image;
+    while (grabbing){
+        shoot(image); /// Take a picture, waits for the camera.
+        if (saveImages)
+            save(image);
+        uint32_t captureMs = millis();
+        {
+            lock_guard<mutex> guard(newestLock);
+            swap(image, newestImage);
+            newestMs = captureMs;
+            newestNumber++;
         }
-        closedir (dir); /// Close the opened directory.
-    } else {
-        /// Could not open directory.
-        perror ("Directory error.");
+        newestArrived.notify_one();
+    }
+}
+
+/** Start the grabber thread. After that, capture() must not be used.
+*/
+void Camera::grabStart(){
+    if (grabbing)
         return;
+    grabbing = true;
+    grabber = thread(&Camera::grab, this);
+}
+
+/** Stop the grabber thread.
+*/
+void Camera::grabStop(){
+    if (!grabbing)
+        return;
+    grabbing = false;
+    grabber.join();
+}
+
+/** Take the newest picture from the grabber. Older ones, never taken, are lost.
+@param image - picture. Its previous buffer is reused by the grabber.
+@param captureMs - capture time, millis()
+@param timeoutMs - maximum wait for a picture newer than the last one taken.
+@return - a new picture
+*/
+bool Camera::newest(Mat &image, uint32_t &captureMs, uint32_t timeoutMs){
+    unique_lock<mutex> guard(newestLock);
+    if (!newestArrived.wait_for(guard, chrono::milliseconds(timeoutMs), [this]{ return newestNumber != newestTaken;}))
+        return false;
+    swap(image, newestImage);
+    captureMs = newestMs;
+    if (newestNumber - newestTaken > 1)
+        Metrics::add(METRIC_FRAMES_DROPPED, newestNumber - newestTaken - 1); /// Overwritten before being taken
+    newestTaken = newestNumber;
+    return true;
+}
+
+/** Store a captured picture to disk.
+@param image - picture as captured
+*/
+void Camera::save(const Mat &image){
+    char fileName[64];
+    sprintf(fileName, "/home/pi/images/%05u%s", lastImageNumber++, format == CAPTURE_YUV420 ? ".yuv.png" : ".png");
+    if (!imwrite(fileName, image))
+        cerr << "Could not write " << fileName << endl;
+}
+
+/** Take a picture, waiting for the camera.
+@param image - picture in the chosen format
+*/
+void Camera::shoot(Mat &image){
+    if (format == CAPTURE_YUV420){
+        /// Y plane, then U and V planes, each a quarter of Y.
+        image.create(pRaspiCamYuv->getHeight() * 3 / 2, pRaspiCamYuv->getWidth(), CV_8UC1);
+        pRaspiCamYuv->grab();
+        pRaspiCamYuv->retrieve(image.data, raspicam::RASPICAM_FORMAT_IGNORE);
+    }
+    else{
+        pRaspiCam->grab();
+        pRaspiCam->retrieve(image);
     }
+    Metrics::add(METRIC_FRAMES_CAPTURED);
 }
 
 /** Keep on capturing until a non-empty picture appears.
@@ -368,6 +464,7 @@ void Camera::waitForCapture(){
             ok = true;
             break;
         }
+        delay(5); /// Do not spin while the camera starts.
     }
     if (!ok){
         cout << "No input image!";
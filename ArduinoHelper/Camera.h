@@ -1,20 +1,36 @@
 #ifndef CAMERA_H_INCLUDED
 #define CAMERA_H_INCLUDED
+#include <raspicam/raspicam.h>
 #include <raspicam/raspicam_cv.h>
+#include "Detector.h"
+#include "Viewer.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
 using namespace cv;
 
+
+/** Camera's picture format.
+*/
+enum CaptureFormat{
+    CAPTURE_BGR, /// 3 channels, converted to HSV by each detector
+    CAPTURE_YUV420 /// I420 planes in one 1-channel Mat: Y (rows * 2 / 3 rows), then U and V subsampled. crossing() uses them directly.
+};
+
 /** Class for all of the computer vision methods
 */
 class Camera{
     public:
         /** Constructor
         @param thresh - Canny threshold.
-        @param saveImages - save images to disk.
+        @param saveImages - save images to disk, for Regression. YUV pictures are stored as 1-channel PNGs named *.yuv.png.
+        @param format - picture format.
         */
-        Camera(int thresh = 100, bool saveImages = false);
+        Camera(int thresh = 100, bool saveImages = false, CaptureFormat format = CAPTURE_BGR);
 
         /** Destructor
         */
@@ -22,6 +38,7 @@ class Camera{
 
         /** Find HSV parameters to maximize number of found circles. Warning: this is no desired result for finding a single ball. To calibrate a sinle ball,
         a viable solution would be to put the ball in a predefined position and then find the values that yield only a single, biggest shape.
+        Robot::TUNE_DETECTOR optimizes accuracy and speed over a labelled corpus instead.
         */
 		void calibrateBall();
 
@@ -30,10 +47,17 @@ class Camera{
         void capture();
 
         /** Detect a geen marker in RoboCup Line crossing.
-        @param display - display picture by picture. A key must be pressed to advance. Otherwise a continuous flow with FPS indicated.
+        @param display - show pictures in a separate thread, without slowing down processing. Key 'q' or Esc ends the program.
         */
         void crossing(bool display = true);
 
+        /** Run all the detectors on the newest frame, in parallel on all the cores. Frames too old are dropped and optional stages (balls,
+        display) skipped if they do not fit into the frame's time budget.
+        @param balls - detect balls too.
+        @param display - show pictures in a separate thread, without slowing down processing. Key 'q' or Esc ends the program.
+        */
+        void detectAll(bool balls, bool display = false);
+
         /** Use trackbars to define HSV (hue, saturation, value) parameters and watch the detected circles changing.
         @param lowH - Hsv lower limit
         @param highH - Hsv upper limit
@@ -51,30 +75,87 @@ class Camera{
         @param highS - hSv upper limit
         @param lowV - hsV lower limit
         @param highV - hsV upper limit
-        @param display - break and show results for each image
+        @param display - show results in a separate thread. Key 'q' or Esc ends the program.
         @param circleCount - number of circles found.
         */
         void findCircles(int lowH, int highH, int lowS, int highS, int lowV, int highV,  bool display, int &circleCount);
 
-        /** Frames Per Second
+        /** Frames Per Second: count a processed frame and update the FPS gauge, served by the metrics instead of printed.
         */
         void fps();
 
+        /** Capture continuously and publish each frame once to shared memory, for other processes (vision worker, logger...).
+        */
+        void serve();
+
+        /** Capture until the first picture arrives, so processing can start at once later.
+        */
+        void warmUp(){ waitForCapture();}
+
         /** A way of testing program with not live images. Instead, read images from disk. Record a few hunders images and run this test each time You change the
-        program to be sure the change didn't break something.
+        program to be sure the change didn't break something. The first run stores golden results, the next ones report changed detections and speed.
         */
         void unitTest();
 
     private:
+        Mat bgrImage; /// Workspace: YUV picture converted for detectors needing BGR
         uint32_t cnt = 0;/// FPS counter
-        raspicam::RaspiCam_Cv* pRaspiCam; /// Camera object
+        Detector detector; /// Computer vision algorithms
+        FloorMap floorMap; /// Floor-plane mapping, if calibrated
+        CaptureFormat format; /// Picture format
+        std::thread grabber; /// Captures continuously, keeping only the newest picture
+        std::atomic<bool> grabbing; /// Grabber should continue
+        std::condition_variable newestArrived; /// Signals a new picture
+        Mat newestImage; /// Newest picture from the grabber
+        std::mutex newestLock; /// Guards newestImage, newestMs and newestNumber
+        uint32_t newestMs = 0; /// Newest picture's capture time
+        uint32_t newestNumber = 0; /// Newest picture's number
+        uint32_t newestTaken = 0; /// Number of the last picture taken by newest()
+        raspicam::RaspiCam_Cv* pRaspiCam; /// Camera object, BGR format
+        raspicam::RaspiCam* pRaspiCamYuv = 0; /// Camera object, YUV format
         uint32_t lastCameraMs; /// Last image capture time
-        uint32_t lastFpsDisplayMs = 0; /// Last FPS display time
         uint16_t lastImageNumber = 0;  /// Used for storing images to disk
         Mat srcImage; /// Raw picture, as camera captured it.
         bool saveImages; /// Saving captured images to disk.
         uint32_t startMs; /// Program start time, used for FPS calculation
         int thresh; /// Threshold for Canny algorithm.
+        Viewer viewer; /// Displays pictures in its own thread
+
+        /** Picture in BGR format.
+        @param image - picture as captured
+        @return - the same picture or, in YUV format, its converted copy.
+        */
+        const Mat &bgr(const Mat &image);
+
+        /** Grabber thread's loop.
+        */
+        void grab();
+
+        /** Start the grabber thread. After that, capture() must not be used.
+        */
+        void grabStart();
+
+        /** Stop the grabber thread.
+        */
+        void grabStop();
+
+        /** Take the newest picture from the grabber. Older ones, never taken, are lost.
+        @param image - picture. Its previous buffer is reused by the grabber.
+        @param captureMs - capture time, millis()
+        @param timeoutMs - maximum wait for a picture newer than the last one taken.
+        @return - a new picture
+        */
+        bool newest(Mat &image, uint32_t &captureMs, uint32_t timeoutMs = 100);
+
+        /** Store a captured picture to disk.
+        @param image - picture as captured
+        */
+        void save(const Mat &image);
+
+        /** Take a picture, waiting for the camera.
+        @param image - picture in the chosen format
+        */
+        void shoot(Mat &image);
 
         /** Keep on capturing until a non-empty picture appears.
         */
@@ -0,0 +1,85 @@
+#include "ChangeDetector.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+/** Any dirty tile in a region?
+@param region - rectangle in the frame
+@return - dirty
+*/
+bool ChangeDetector::dirty(Rect region) const{
+    region &= Rect(0, 0, frameSize.width, frameSize.height);
+    if (region.area() == 0 || tileSize == 0)
+        return false;
+    /// The last row and column of tiles also cover the frame's edge lost in downsampling.
+    int lastRow = min(tileRows - 1, (region.br().y - 1) / tileSize), lastCol = min(tileCols - 1, (region.br().x - 1) / tileSize);
+    for (int row = min(tileRows - 1, region.y / tileSize); row <= lastRow; row++)
+        for (int col = min(tileCols - 1, region.x / tileSize); col <= lastCol; col++)
+            if (dirtyFlags[row * tileCols + col])
+                return true;
+    return false;
+}
+
+/** Compare a frame with the reference: each tile with the frame it was last dirty in.
+@param frame - BGR picture or luminance
+@param tile - tile's side in the frame, pixels. A multiple of CHANGE_SCALE.
+@param threshold - a tile is dirty if its mean absolute difference per downsampled pixel is bigger.
+@param refreshFrames - all the tiles are dirty every this many frames, never forced if 0.
+@return - number of dirty tiles
+*/
+int ChangeDetector::update(const Mat &frame, int tile, int threshold, int refreshFrames){
+    /// Downsample first, so the color conversion, if any, is cheap.
+    resize(frame, small, Size(max(1, frame.cols / CHANGE_SCALE), max(1, frame.rows / CHANGE_SCALE)), 0, 0, INTER_AREA);
+    if (small.channels() == 3){
+        cvtColor(small, gray, COLOR_BGR2GRAY);
+        swap(gray, current);
+    }
+    else
+        small.copyTo(current);
+
+    tile = max(CHANGE_SCALE, tile / CHANGE_SCALE * CHANGE_SCALE);
+    bool refresh = forceRefresh || frame.size() != frameSize || tile != tileSize || previous.size() != current.size() ||
+        (refreshFrames > 0 && ++frameCount >= (uint32_t)refreshFrames);
+    if (refresh)
+        frameCount = 0;
+    forceRefresh = false;
+    frameSize = frame.size();
+    tileSize = tile;
+    /// The grid covers the downsampled frame, so no tile is empty there.
+    int side = tileSize / CHANGE_SCALE;
+    tileCols = (current.cols + side - 1) / side;
+    tileRows = (current.rows + side - 1) / side;
+    dirtyFlags.assign(tileCols * tileRows, refresh);
+    dirtyRects.clear();
+
+    if (!refresh)
+        absdiff(current, previous, difference);
+    Rect smallFrame(0, 0, current.cols, current.rows);
+    Rect wholeFrame(0, 0, frameSize.width, frameSize.height);
+    for (int row = 0; row < tileRows; row++)
+        for (int col = 0; col < tileCols; col++){
+            if (!refresh){
+                Rect smallTile = Rect(col * side, row * side, side, side) & smallFrame;
+                /// Sum of absolute differences, compared as a mean to be independent of the tile's size.
+                dirtyFlags[row * tileCols + col] = sum(difference(smallTile))[0] > (double)threshold * smallTile.area();
+                if (dirtyFlags[row * tileCols + col]){
+                    Mat reference = previous(smallTile);
+                    current(smallTile).copyTo(reference); /// Processed again, the new reference.
+                }
+            }
+            if (dirtyFlags[row * tileCols + col]){
+                Rect frameTile(col * tileSize, row * tileSize, tileSize, tileSize);
+                if (col == tileCols - 1)
+                    frameTile.width = frameSize.width - frameTile.x; /// Up to the edge lost in downsampling
+                if (row == tileRows - 1)
+                    frameTile.height = frameSize.height - frameTile.y;
+                dirtyRects.push_back(frameTile & wholeFrame);
+            }
+        }
+
+    /// Clean tiles keep their reference, so a slow drift adds up until it makes them dirty.
+    if (refresh)
+        swap(current, previous);
+    return dirtyRects.size();
+}
@@ -0,0 +1,62 @@
+#ifndef CHANGEDETECTOR_H_INCLUDED
+#define CHANGEDETECTOR_H_INCLUDED
+#include <opencv2/imgproc/imgproc.hpp>
+#include <stdint.h>
+#include <vector>
+
+#define CHANGE_SCALE 4 /// Luminance is compared at 1/CHANGE_SCALE of the frame's width and height.
+
+using namespace cv;
+
+/** Finds the tiles of a frame that changed: block-wise sum of absolute differences of downsampled luminance. Each tile is compared with
+the frame it was last dirty in, the one its kept results come from, so a slow drift adds up until the tile is dirty. Clean tiles' previous
+results can be reused. All the tiles are dirty in the first frame, after a size change, after reset() and every refreshFrames frames.
+*/
+class ChangeDetector{
+    public:
+        /** Compare a frame with the reference: each tile with the frame it was last dirty in.
+        @param frame - BGR picture or luminance
+        @param tile - tile's side in the frame, pixels. A multiple of CHANGE_SCALE.
+        @param threshold - a tile is dirty if its mean absolute difference per downsampled pixel is bigger.
+        @param refreshFrames - all the tiles are dirty every this many frames, never forced if 0.
+        @return - number of dirty tiles
+        */
+        int update(const Mat &frame, int tile, int threshold, int refreshFrames);
+
+        /** All the tiles dirty in the next frame, for example when the kept results were discarded.
+        */
+        void reset(){ forceRefresh = true;}
+
+        /** Any dirty tile in a region?
+        @param region - rectangle in the frame
+        @return - dirty
+        */
+        bool dirty(Rect region) const;
+
+        /** Dirty tiles, in the frame.
+        @return - rectangles, clipped to the frame.
+        */
+        const std::vector<Rect> &dirtyTiles() const{ return dirtyRects;}
+
+        /** Number of tiles.
+        @return - count
+        */
+        int tileCount() const{ return tileCols * tileRows;}
+
+    private:
+        Mat current; /// Downsampled luminance
+        Mat difference; /// Absolute difference to the previous one
+        std::vector<Rect> dirtyRects; /// Dirty tiles, in the frame
+        std::vector<uint8_t> dirtyFlags; /// Tiles, row by row: dirty
+        bool forceRefresh = false; /// All the tiles dirty in the next frame
+        uint32_t frameCount = 0; /// Frames since the last full refresh
+        Size frameSize; /// Last frame's size
+        Mat gray; /// Downsampled BGR frame's luminance
+        Mat previous; /// Reference downsampled luminance, each tile from the frame it was last dirty in
+        Mat small; /// Downsampled frame
+        int tileCols = 0; /// Tiles in a row
+        int tileRows = 0; /// Tiles in a column
+        int tileSize = 0; /// Tile's side in the frame
+};
+
+#endif // CHANGEDETECTOR_H_INCLUDED
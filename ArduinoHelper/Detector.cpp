@@ -0,0 +1,431 @@
+#include "Detector.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <wiringPi.h>
+
+#define MARKER_CHECK_AHEAD_MM 30 /// Floor distance from the marker's centre to the black-check area ahead of it
+#define MARKER_CHECK_SIDE_MM 30 /// Floor distance from the marker's centre to the black-check areas on its sides
+#define MARKER_CHECK_SQUARE_MM 12 /// Black-check area's side on the floor
+
+using namespace std;
+using namespace cv;
+
+/** Constructor
+@param thresh - Canny threshold.
+*/
+Detector::Detector(int threshold){
+    params.cannyThreshold = threshold;
+}
+
+/** Detect a green marker in RoboCup Line crossing, and the line.
+@param image - BGR picture, as camera captured it. Upper part will be cropped.
+@param detections - marker, green blobs and line found.
+*/
+void Detector::crossing(const Mat &image, Detections &detections){
+
+    uint32_t startUs = micros();
+
+    /// Crop the picture, remove upper part.
+    imgRoi = image(crop(image.size()));
+
+    if (changeDetection){
+        if (crossingReuse(imgRoi, detections, startUs))
+            return;
+
+        /// Change colorspace to HSV (hue, saturation, value), only where the picture changed.
+        if (crossingReusable && imgHSVKept.size() == imgRoi.size())
+            for (const Rect &tile : changes.dirtyTiles()){
+                Mat hsvTile = imgHSVKept(tile);
+                cvtColor(imgRoi(tile), hsvTile, COLOR_BGR2HSV);
+            }
+        else
+            cvtColor(imgRoi, imgHSVKept, COLOR_BGR2HSV);
+    }
+    else
+        cvtColor(imgRoi, imgHSV, COLOR_BGR2HSV); /// Change colorspace to HSV (hue, saturation, value).
+    const Mat &hsv = changeDetection ? imgHSVKept : imgHSV;
+
+    detections.overlay.clear();
+    stageGreen(hsv);
+    stageBlack(hsv);
+    stageLine(detections);
+    stageMarker(detections);
+
+    detections.ms = (micros() - startUs) / 1000.0;
+    crossingKeep(detections);
+    Metrics::set(METRIC_CROSSING_US, micros() - startUs);
+}
+
+/** Detect a green marker in RoboCup Line crossing, and the line, using YUV planes directly: black on Y, green on subsampled U and V.
+No color conversion.
+@param image - I420 picture, 1 channel: Y plane (rows * 2 / 3 rows), then U and V planes. Continuous, as the planes' offsets assume no
+padding. Upper part will be cropped.
+@param detections - marker, green blobs and line found.
+*/
+void Detector::crossingYuv(const Mat &image, Detections &detections){
+
+    uint32_t startUs = micros();
+
+    /// Planes share data with the picture. U and V have half the width and height. Padding would shift them, it is not supported.
+    CV_Assert(image.isContinuous());
+    int rows = image.rows * 2 / 3;
+    int cols = image.cols;
+    uint8_t *data = (uint8_t*)image.data;
+    Mat y(rows, cols, CV_8UC1, data);
+    Mat u(rows / 2, cols / 2, CV_8UC1, data + rows * cols);
+    Mat v(rows / 2, cols / 2, CV_8UC1, data + rows * cols * 5 / 4);
+
+    /// Crop the planes, remove upper part.
+    Rect roi = crop(Size(cols, rows));
+    Rect roiHalf(roi.x / 2, roi.y / 2, roi.width / 2, roi.height / 2);
+    imgRoi = y(roi);
+    if (changeDetection && crossingReuse(imgRoi, detections, startUs))
+        return;
+
+    detections.overlay.clear();
+    stageGreenUV(u(roiHalf), v(roiHalf));
+    stageBlackY(imgRoi);
+    stageLine(detections);
+    stageMarker(detections);
+
+    detections.ms = (micros() - startUs) / 1000.0;
+    Metrics::set(METRIC_CROSSING_US, micros() - startUs);
+    crossingKeep(detections);
+}
+
+/** Detect circles using HSV limits.
+@param image - BGR picture.
+@param lowH - Hsv lower limit
+@param highH - Hsv upper limit
+@param lowS - hSv lower limit
+@param highS - hSv upper limit
+@param lowV - hsV lower limit
+@param highV - hsV upper limit
+@param detections - balls found.
+*/
+void Detector::circles(const Mat &image, int lowH, int highH, int lowS, int highS, int lowV, int highV, Detections &detections){
+
+    uint32_t startUs = micros();
+    detections.overlay.clear();
+
+    /// Limits:
+    if (highH > 179) highH = 179;
+    if (highS > 255) highS = 255;
+    if (highV > 255) highV = 255;
+
+    /// Convert image to HSV space (hue, saturation, value).
+    cvtColor(image, imgHSV, COLOR_BGR2HSV);
+
+    stageBalls(imgHSV, Scalar(lowH, lowS, lowV), Scalar(highH, highS, highV), detections);
+
+    detections.ms = (micros() - startUs) / 1000.0;
+    Metrics::set(METRIC_CIRCLES_US, micros() - startUs);
+}
+
+/** Keep crossing detections for change detection.
+@param detections - this frame's detections
+*/
+void Detector::crossingKeep(const Detections &detections){
+    if (!changeDetection)
+        return;
+    crossingLast = detections;
+    crossingReusable = true;
+}
+
+/** Compare the cropped picture with the reference and, if no tile changed, reuse the previous crossing detections.
+@param roi - cropped picture, BGR or luminance
+@param detections - previous detections, if reused.
+@param startUs - processing's start, micros()
+@return - reused, nothing else to do.
+*/
+bool Detector::crossingReuse(const Mat &roi, Detections &detections, uint32_t startUs){
+    int dirtyCount = changes.update(roi, params.changeTile, params.changeThreshold, params.changeRefresh);
+    Metrics::set(METRIC_TILES_DIRTY, dirtyCount);
+    if (dirtyCount != 0 || !crossingReusable)
+        return false;
+    detections = crossingLast;
+    detections.ms = (micros() - startUs) / 1000.0;
+    Metrics::add(METRIC_FRAMES_REUSED);
+    return true;
+}
+
+/** Cropped part of the picture that crossing() and detectAll() use for line and marker.
+@param frame - whole picture's size
+@return - rectangle
+*/
+Rect Detector::crop(Size frame){
+    int yStart = frame.height * 0.35;
+    return Rect(0, yStart, frame.width, frame.height - yStart);
+}
+
+/** All the detectors for one frame: the shared stages (crop, HSV conversion) run once, then independent detectors run in parallel.
+@param image - BGR picture, as camera captured it.
+@param pool - threads executing detectors.
+@param balls - detect balls too, using limits set by ballLimits().
+@param detections - line, marker, green blobs and balls found.
+*/
+void Detector::detectAll(const Mat &image, ThreadPool &pool, bool balls, Detections &detections){
+
+    uint32_t startUs = micros();
+    detections.overlay.clear();
+    detections.balls.clear();
+
+    /// Shared stages: crop and HSV conversion of the whole picture, as balls may be anywhere.
+    Rect roi = crop(image.size());
+    imgRoi = image(roi);
+    cvtColor(image, imgHSV, COLOR_BGR2HSV);
+    Mat hsvRoi = imgHSV(roi);
+
+    /// Fan out: independent detectors.
+    TaskGroup group;
+    pool.run(group, [this, &hsvRoi, &detections]{
+        stageBlack(hsvRoi);
+        stageLine(detections);
+    });
+    pool.run(group, [this, &hsvRoi]{ stageGreen(hsvRoi);});
+    if (balls)
+        pool.run(group, [this]{
+            uint32_t ballsStartUs = micros();
+            stageBalls(imgHSV, params.ballLow, params.ballHigh, ballDetections);
+            ballDetections.ballsMs = (micros() - ballsStartUs) / 1000.0;
+            Metrics::set(METRIC_BALLS_US, micros() - ballsStartUs);
+        });
+    pool.wait(group);
+
+    /// Join: marker needs both green and black parts.
+    stageMarker(detections);
+    detections.ballsMs = 0;
+    if (balls){
+        detections.ballsMs = ballDetections.ballsMs;
+        detections.balls.swap(ballDetections.balls);
+        detections.overlay.insert(detections.overlay.end(), ballDetections.overlay.begin(), ballDetections.overlay.end());
+        ballDetections.overlay.clear();
+    }
+
+    detections.ms = (micros() - startUs) / 1000.0;
+    Metrics::set(METRIC_DETECT_ALL_US, micros() - startUs);
+}
+
+/** Load a tuned profile over the current parameters. Every Detector processing live frames should, so all the processes agree.
+@param fileName - profile
+@return - loaded, otherwise the parameters are unchanged.
+*/
+bool Detector::profileLoad(const string &fileName){
+    DetectorParams loaded = params;
+    if (!loaded.load(fileName))
+        return false;
+    paramsSet(loaded);
+    return true;
+}
+
+/** Replace all the parameters, for example with a tuned profile.
+@param params - parameters
+*/
+void Detector::paramsSet(const DetectorParams &paramsNow){
+    params = paramsNow;
+    ballsHough.paramsSet(params);
+    ballsContour.paramsSet(params);
+    if (params.ballEngine != BALLS_CONTOUR)
+        params.ballEngine = BALLS_HOUGH; /// Unknown engine in the profile
+    crossingReusable = false; /// Previous results came from other parameters.
+    changes.reset();
+}
+
+/** Picture's rectangle covering a square on the floor.
+@param centre - square's centre, mm
+@param side - square's side, mm
+@return - rectangle in the cropped picture
+*/
+Rect Detector::floorSquare(Point2f centre, float side) const{
+    Point2f corners[4] = {Point2f(-side / 2, -side / 2), Point2f(side / 2, -side / 2), Point2f(side / 2, side / 2), Point2f(-side / 2, side / 2)};
+    float minimumX = 1e9, maximumX = -1e9, minimumY = 1e9, maximumY = -1e9;
+    for (int i = 0; i < 4; i++){
+        Point2f image = floorMap->toImage(centre + corners[i]);
+        minimumX = min(minimumX, image.x);
+        maximumX = max(maximumX, image.x);
+        minimumY = min(minimumY, image.y);
+        maximumY = max(maximumY, image.y);
+    }
+    return Rect(Point(cvRound(minimumX), cvRound(minimumY)), Point(max(cvRound(maximumX), cvRound(minimumX) + 1), max(cvRound(maximumY), cvRound(minimumY) + 1)));
+}
+
+/** Stage: balls' color, ball detection algorithm.
+@param hsv - picture in HSV colorspace
+@param low - HSV lower limits. If H limit is bigger than the upper one, H range wraps around.
+@param high - HSV upper limits
+@param detections - balls found.
+*/
+void Detector::stageBalls(const Mat &hsv, Scalar low, Scalar high, Detections &detections){
+    detections.balls.clear();
+
+    /// Separate colors
+    if(low[0] > high[0]) /// A more complicated case when end and beginning part of H is requested.
+    {
+        maskCircles.inRange(hsv, Scalar(0, low[1], low[2]), high);
+        maskCircles2.inRange(hsv, low, Scalar(179, high[1], high[2]));
+        maskCircles |= maskCircles2;
+    }
+    else
+        maskCircles.inRange(hsv, low, high);
+
+    /// Remove small islands.
+    maskCircles.open(Size(params.ballKernel, params.ballKernel));
+    maskCircles.toMat(imgThresholded);
+
+    if (params.ballEngine == BALLS_CONTOUR)
+        ballsContour.detect(imgThresholded, detections.balls);
+    else
+        ballsHough.detect(imgThresholded, detections.balls);
+
+    if (overlayEnabled)
+        for (size_t i = 0; i < detections.balls.size(); i++){
+            /// Centre and circular outline
+            overlayCircle(detections.overlay, detections.balls[i].centre, 1, Scalar(0, 100, 100), 3);
+            overlayCircle(detections.overlay, detections.balls[i].centre, detections.balls[i].radius, Scalar(255, 0, 255), 3);
+        }
+}
+
+/** Stage: black part of the cropped picture and its summed-area table.
+@param hsv - cropped picture in HSV colorspace
+*/
+void Detector::stageBlack(const Mat &hsv){
+    /// Separata black parts.
+    maskBlack.inRange(hsv, Scalar(0, 0, 0), Scalar(179, 255, params.blackMaximumV));
+    integralBlack.build(maskBlack);
+}
+
+/** Stage: black part of the cropped picture from its luminance, and its summed-area table.
+@param y - cropped Y plane
+*/
+void Detector::stageBlackY(const Mat &y){
+    maskBlack.inRange(y, Scalar(0), Scalar(params.yuvBlackMaximumY));
+    integralBlack.build(maskBlack);
+}
+
+/** Stage: contours of the green part, imgThresholdGreen.
+*/
+void Detector::stageContours(){
+    /// Canny - find edges
+    Canny(imgThresholdGreen, cannyOutput, params.cannyThreshold, params.cannyThreshold * 2, 3);
+
+    /// Find (all) contours
+    findContours(cannyOutput, contoursFound, hierarchyFound, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0));
+}
+
+/** Stage: green part of the cropped picture, its contours.
+@param hsv - cropped picture in HSV colorspace
+*/
+void Detector::stageGreen(const Mat &hsv){
+    /// Separate the green part.
+    maskGreen.inRange(hsv, params.greenLow, params.greenHigh);
+
+    /// Erode and dilate the image to delete small islands inside and outside.
+    maskGreen.open(Size(params.greenKernel, params.greenKernel));
+    maskGreen.toMat(imgThresholdGreen);
+
+    stageContours();
+}
+
+/** Stage: green part of the cropped picture from its chroma, its contours.
+@param u - cropped U plane, half resolution
+@param v - cropped V plane, half resolution
+*/
+void Detector::stageGreenUV(const Mat &u, const Mat &v){
+    /// Green has both chroma components well below neutral 128.
+    maskGreen.inRange(u, Scalar(0), Scalar(params.yuvGreenMaximumU));
+    maskGreen2.inRange(v, Scalar(0), Scalar(params.yuvGreenMaximumV));
+    maskGreen &= maskGreen2;
+
+    /// Delete small islands. Half resolution, so a smaller structuring element.
+    int kernel = max(1, params.greenKernel / 2) | 1;
+    maskGreen.open(Size(kernel, kernel));
+    maskGreen.toMat(imgGreenHalf);
+
+    /// Back to the Y plane's resolution, so contours match the black part.
+    resize(imgGreenHalf, imgThresholdGreen, Size(imgRoi.cols, imgRoi.rows), 0, 0, INTER_NEAREST);
+
+    stageContours();
+}
+
+/** Stage: line position, from the black part.
+@param detections - line found.
+*/
+void Detector::stageLine(Detections &detections){
+    /// Black pixels' centre of gravity in the bottom quarter, nearest to the robot. Each column's count comes from the summed-area table.
+    int yStart = maskBlack.rows * 3 / 4;
+    uint32_t count = 0, sumX = 0;
+    for (int x = 0; x < maskBlack.cols; x++){
+        uint32_t column = integralBlack.count(Rect(x, yStart, 1, maskBlack.rows - yStart));
+        count += column;
+        sumX += x * column;
+    }
+
+    /// Ignore a few noisy pixels.
+    detections.lineX = count > (uint32_t)maskBlack.cols / 4 ? sumX / count : -1;
+    detections.lineFloorX = NAN;
+    if (detections.lineX != -1 && floorMap != 0)
+        detections.lineFloorX = floorMap->toFloor(Point(detections.lineX, (yStart + maskBlack.rows) / 2)).x;
+}
+
+/** Stage: marker decision, from green contours and the black part.
+@param detections - marker and green blobs found.
+*/
+void Detector::stageMarker(Detections &detections){
+    detections.marker = MARKER_NONE;
+    detections.blobs.clear();
+
+    /// Check every countour
+    for (uint16_t i = 0; i < contoursFound.size(); i++){
+        /// Calculate moments: center of gravity and area
+        Moments oMoments = moments(contoursFound[i]);
+        double dM01 = oMoments.m01;
+        double dM10 = oMoments.m10;
+        double area = oMoments.m00;
+        int cX = dM10 / area; /// Gravity centre's x
+        int cY = dM01 / area; /// y
+
+        /// If area is big enough, it can be a marker
+        if (area > imgRoi.cols * imgRoi.rows / params.blobAreaDivisor){
+            Blob blob = {Point(cX, cY), area};
+            detections.blobs.push_back(blob);
+
+            /// Black-check areas: squares around 3 points, left, right and above the marker. Mostly black squares count as black.
+            Rect left, right, above;
+            if (floorMap != 0){
+                /// Fixed distances on the floor, whatever the marker's distance from the robot.
+                Point2f centre = floorMap->toFloor(Point(cX, cY));
+                left = floorSquare(centre + Point2f(-MARKER_CHECK_SIDE_MM, 0), MARKER_CHECK_SQUARE_MM);
+                right = floorSquare(centre + Point2f(MARKER_CHECK_SIDE_MM, 0), MARKER_CHECK_SQUARE_MM);
+                above = floorSquare(centre + Point2f(0, MARKER_CHECK_AHEAD_MM), MARKER_CHECK_SQUARE_MM);
+            }
+            else{
+                int dX = imgRoi.cols * 0.16;
+                int dY = imgRoi.rows * 0.28;
+                int side = max(3, dX / 2);
+                left = Rect(cX - dX - side / 2, cY - side / 2, side, side);
+                right = Rect(cX + dX - side / 2, cY - side / 2, side, side);
+                above = Rect(cX - side / 2, cY - dY - side / 2, side, side);
+            }
+
+            if (overlayEnabled){
+                /// Label the marker, outline the contour (in green) and show 3 black-check areas (in red).
+                overlayText(detections.overlay, Point(cX - 10, cY), "Marker", Scalar(0, 255, 0));
+                overlayPolygon(detections.overlay, contoursFound[i], Scalar(0, 255, 0), 2);
+                overlayRectangle(detections.overlay, left, Scalar(0, 0, 255));
+                overlayRectangle(detections.overlay, right, Scalar(0, 0, 255));
+                overlayRectangle(detections.overlay, above, Scalar(0, 0, 255));
+            }
+
+            if (integralBlack.fill(above) > params.blackFill){ /// If area above is black, this can be a marker
+                if (integralBlack.fill(left) > params.blackFill){ /// if the one to the left is also black, this is a right marker.
+                    detections.marker = MARKER_RIGHT;
+                    break;
+                }
+                else if (integralBlack.fill(right) > params.blackFill){/// if the one to the right is also black, this is a left marker.
+                    detections.marker = MARKER_LEFT;
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,251 @@
+#ifndef DETECTOR_H_INCLUDED
+#define DETECTOR_H_INCLUDED
+#include "BallDetector.h"
+#include "BinaryMask.h"
+#include "ChangeDetector.h"
+#include "FloorMap.h"
+#include "IntegralImage.h"
+#include "Overlay.h"
+#include "ThreadPool.h"
+#include <math.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <vector>
+
+using namespace cv;
+
+/** Marker's position, as decided by the black-check areas around a green blob.
+*/
+enum Marker {MARKER_NONE, MARKER_LEFT, MARKER_RIGHT};
+
+/** A green blob big enough to be a marker.
+*/
+struct Blob{
+    Point centre; /// Gravity centre
+    double area; /// Area in pixels
+};
+
+/** A ball found by the circle detection.
+*/
+struct Ball{
+    Point2f centre; /// Circle's centre
+    float radius; /// Circle's radius
+};
+
+/** Everything detectors found in one frame.
+*/
+struct Detections{
+    Marker marker = MARKER_NONE; /// Crossing marker
+    std::vector<Blob> blobs; /// Green blobs checked for being a marker
+    std::vector<Ball> balls; /// Circles
+    int lineX = -1; /// Line's position in the cropped picture, -1 if not found
+    float lineFloorX = NAN; /// Line's lateral offset on the floor, mm, right positive. NAN if not found or no floor calibration.
+    Overlay overlay; /// Drawing primitives, if enabled in Detector
+    double ms = 0; /// Processing time
+    double ballsMs = 0; /// Part of processing time spent on balls
+};
+
+/** Computer vision algorithms working on a single frame. Each object owns its workspace (intermediate images), so more objects can work in parallel.
+*/
+class Detector{
+    public:
+        /** Constructor
+        @param thresh - Canny threshold.
+        */
+        Detector(int thresh = 100);
+
+        /** Detect a green marker in RoboCup Line crossing, and the line.
+        @param image - BGR picture, as camera captured it. Upper part will be cropped.
+        @param detections - marker, green blobs and line found.
+        */
+        void crossing(const Mat &image, Detections &detections);
+
+        /** Detect a green marker in RoboCup Line crossing, and the line, using YUV planes directly: black on Y, green on subsampled U and V.
+        No color conversion.
+        @param image - I420 picture, 1 channel: Y plane (rows * 2 / 3 rows), then U and V planes. Continuous, as the planes' offsets assume
+        no padding. Upper part will be cropped.
+        @param detections - marker, green blobs and line found.
+        */
+        void crossingYuv(const Mat &image, Detections &detections);
+
+        /** Detect circles using HSV limits.
+        @param image - BGR picture.
+        @param lowH - Hsv lower limit
+        @param highH - Hsv upper limit
+        @param lowS - hSv lower limit
+        @param highS - hSv upper limit
+        @param lowV - hsV lower limit
+        @param highV - hsV upper limit
+        @param detections - balls found.
+        */
+        void circles(const Mat &image, int lowH, int highH, int lowS, int highS, int lowV, int highV, Detections &detections);
+
+        /** All the detectors for one frame: the shared stages (crop, HSV conversion) run once, then independent detectors run in parallel.
+        @param image - BGR picture, as camera captured it.
+        @param pool - threads executing detectors.
+        @param balls - detect balls too, using limits set by ballLimits().
+        @param detections - line, marker, green blobs and balls found.
+        */
+        void detectAll(const Mat &image, ThreadPool &pool, bool balls, Detections &detections);
+
+        /** Skip unchanged parts of consecutive frames in crossing() and crossingYuv(). If no tile changed, the previous detections are reused.
+        Otherwise crossing() converts only the dirty tiles to HSV; thresholds, contours and the line still run on the whole picture. For a
+        stream of frames only, off by default.
+        @param enable - use change detection
+        */
+        void changeDetectionEnable(bool enable){ changeDetection = enable; crossingReusable = false; changes.reset();}
+
+        /** Cropped part of the picture that crossing() and detectAll() use for line and marker.
+        @param frame - whole picture's size
+        @return - rectangle
+        */
+        static Rect crop(Size frame);
+
+        /** Choose ball detection algorithm, overriding the profile's ballEngine.
+        @param engine - algorithm
+        */
+        void ballEngineSet(BallEngine engine){ params.ballEngine = engine;}
+
+        /** HSV limits for balls in detectAll().
+        @param low - lower limits
+        @param high - upper limits
+        */
+        void ballLimits(Scalar low, Scalar high){ params.ballLow = low; params.ballHigh = high;}
+
+        /** Use floor-plane coordinates for line and marker logic. Without it, fixed fractions of the picture are used.
+        @param map - calibrated mapping, built for crop(). Not owned, must outlive the detector. 0 to stop using it.
+        */
+        void floorMapSet(const FloorMap *map){ floorMap = map;}
+
+        /** Current parameters.
+        @return - parameters
+        */
+        const DetectorParams &paramsGet() const{ return params;}
+
+        /** Load a tuned profile over the current parameters. Every Detector processing live frames should, so all the processes agree.
+        @param fileName - profile
+        @return - loaded, otherwise the parameters are unchanged.
+        */
+        bool profileLoad(const std::string &fileName = DETECTOR_PROFILE);
+
+        /** Replace all the parameters, for example with a tuned profile.
+        @param params - parameters
+        */
+        void paramsSet(const DetectorParams &params);
+
+        /** Last crossing() cropped picture. It shares data with the input image.
+        @return - picture
+        */
+        Mat &roi(){ return imgRoi;}
+
+        /** Last black part.
+        @return - thresholded picture
+        */
+        const BinaryMask &thresholdBlack(){ return maskBlack;}
+
+        /** Last green part.
+        @return - thresholded picture
+        */
+        Mat &thresholdGreen(){ return imgThresholdGreen;}
+
+        /** List drawing primitives in Detections. Off by default, to keep processing as fast as possible.
+        @param enable - list them
+        */
+        void overlayEnable(bool enable){ overlayEnabled = enable;}
+
+        /** Last circles() thresholded picture.
+        @return - thresholded picture
+        */
+        Mat &thresholdCircles(){ return imgThresholded;}
+
+    private:
+        Detections ballDetections; /// Balls found by detectAll(), merged after the join
+        ContourBallDetector ballsContour; /// Contour circularity algorithm
+        HoughBallDetector ballsHough; /// Hough algorithm
+        Mat cannyOutput; /// Edges
+        bool changeDetection = false; /// Skip unchanged tiles
+        ChangeDetector changes; /// Dirty tiles of the cropped picture
+        Detections crossingLast; /// Last crossing detections, reused if nothing changed
+        bool crossingReusable = false; /// crossingLast and imgHSVKept belong to the previous frame
+        const FloorMap *floorMap = 0; /// Floor-plane mapping, 0 if not calibrated
+        std::vector<std::vector<Point> > contoursFound; /// All contours
+        std::vector<Vec4i> hierarchyFound; /// Contours' hierarchy
+        Mat imgHSV; /// Picture in HSV colorspace
+        Mat imgHSVKept; /// crossing()'s HSV picture, kept between frames for change detection
+        Mat imgRoi; /// Cropped picture
+        Mat imgThresholdGreen; /// Green part, for Canny
+        Mat imgThresholded; /// Circles' color, for Hough
+        IntegralImage integralBlack; /// Black part's summed-area table
+        BinaryMask maskBlack; /// Black part
+        BinaryMask maskCircles; /// Circles' color
+        BinaryMask maskCircles2; /// Circles' color, second part of H range
+        BinaryMask maskGreen; /// Green part
+        BinaryMask maskGreen2; /// Green part, second chroma plane
+        Mat imgGreenHalf; /// Green part at chroma planes' resolution
+        bool overlayEnabled = false; /// List drawing primitives
+        DetectorParams params; /// Tunable parameters
+
+        /** Keep crossing detections for change detection.
+        @param detections - this frame's detections
+        */
+        void crossingKeep(const Detections &detections);
+
+        /** Compare the cropped picture with the reference and, if no tile changed, reuse the previous crossing detections.
+        @param roi - cropped picture, BGR or luminance
+        @param detections - previous detections, if reused.
+        @param startUs - processing's start, micros()
+        @return - reused, nothing else to do.
+        */
+        bool crossingReuse(const Mat &roi, Detections &detections, uint32_t startUs);
+
+        /** Picture's rectangle covering a square on the floor.
+        @param centre - square's centre, mm
+        @param side - square's side, mm
+        @return - rectangle in the cropped picture
+        */
+        Rect floorSquare(Point2f centre, float side) const;
+
+        /** Stage: balls' color, ball detection algorithm.
+        @param hsv - picture in HSV colorspace
+        @param low - HSV lower limits. If H limit is bigger than the upper one, H range wraps around.
+        @param high - HSV upper limits
+        @param detections - balls found.
+        */
+        void stageBalls(const Mat &hsv, Scalar low, Scalar high, Detections &detections);
+
+        /** Stage: black part of the cropped picture and its summed-area table.
+        @param hsv - cropped picture in HSV colorspace
+        */
+        void stageBlack(const Mat &hsv);
+
+        /** Stage: black part of the cropped picture from its luminance, and its summed-area table.
+        @param y - cropped Y plane
+        */
+        void stageBlackY(const Mat &y);
+
+        /** Stage: contours of the green part, imgThresholdGreen.
+        */
+        void stageContours();
+
+        /** Stage: green part of the cropped picture, its contours.
+        @param hsv - cropped picture in HSV colorspace
+        */
+        void stageGreen(const Mat &hsv);
+
+        /** Stage: green part of the cropped picture from its chroma, its contours.
+        @param u - cropped U plane, half resolution
+        @param v - cropped V plane, half resolution
+        */
+        void stageGreenUV(const Mat &u, const Mat &v);
+
+        /** Stage: line position, from the black part.
+        @param detections - line found.
+        */
+        void stageLine(Detections &detections);
+
+        /** Stage: marker decision, from green contours and the black part.
+        @param detections - marker and green blobs found.
+        */
+        void stageMarker(Detections &detections);
+};
+
+#endif // DETECTOR_H_INCLUDED
@@ -0,0 +1,116 @@
+#include "DetectorParams.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+/** One parameter in a profile. Exactly one pointer is set.
+*/
+struct ParamField{
+    const char *name; /// Name in the file
+    int *integer; /// Integer parameter
+    float *real; /// Real parameter
+    Scalar *scalar; /// 3 values, comma-separated in the file
+};
+
+/** All the parameters.
+@param params - parameters
+@return - their names and addresses
+*/
+static vector<ParamField> paramFields(DetectorParams &params){
+    ParamField fields[] = {
+        {"cannyThreshold", &params.cannyThreshold, 0, 0},
+        {"greenLow", 0, 0, &params.greenLow},
+        {"greenHigh", 0, 0, &params.greenHigh},
+        {"greenKernel", &params.greenKernel, 0, 0},
+        {"blackMaximumV", &params.blackMaximumV, 0, 0},
+        {"yuvBlackMaximumY", &params.yuvBlackMaximumY, 0, 0},
+        {"yuvGreenMaximumU", &params.yuvGreenMaximumU, 0, 0},
+        {"yuvGreenMaximumV", &params.yuvGreenMaximumV, 0, 0},
+        {"blobAreaDivisor", &params.blobAreaDivisor, 0, 0},
+        {"blackFill", 0, &params.blackFill, 0},
+        {"ballLow", 0, 0, &params.ballLow},
+        {"ballHigh", 0, 0, &params.ballHigh},
+        {"ballKernel", &params.ballKernel, 0, 0},
+        {"ballEngine", &params.ballEngine, 0, 0},
+        {"houghDistanceDivisor", &params.houghDistanceDivisor, 0, 0},
+        {"houghCanny", &params.houghCanny, 0, 0},
+        {"houghVotes", &params.houghVotes, 0, 0},
+        {"houghMinimumRadius", &params.houghMinimumRadius, 0, 0},
+        {"houghMaximumRadius", &params.houghMaximumRadius, 0, 0},
+        {"contourDistanceDivisor", &params.contourDistanceDivisor, 0, 0},
+        {"contourMinimumRadius", &params.contourMinimumRadius, 0, 0},
+        {"contourCircularity", 0, &params.contourCircularity, 0},
+        {"contourFill", 0, &params.contourFill, 0},
+        {"changeTile", &params.changeTile, 0, 0},
+        {"changeThreshold", &params.changeThreshold, 0, 0},
+        {"changeRefresh", &params.changeRefresh, 0, 0}};
+    return vector<ParamField>(fields, fields + sizeof(fields) / sizeof(fields[0]));
+}
+
+/** Read a profile.
+@param fileName - file
+@return - success
+*/
+bool DetectorParams::load(const string &fileName){
+    ifstream file(fileName.c_str());
+    if (!file)
+        return false;
+
+    vector<ParamField> fields = paramFields(*this);
+    string line;
+    while (getline(file, line)){
+        size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == string::npos)
+            continue;
+        string name = line.substr(0, equals);
+        istringstream in(line.substr(equals + 1));
+        size_t i;
+        for (i = 0; i < fields.size() && name != fields[i].name; i++)
+            ;
+        if (i == fields.size()){
+            cerr << fileName << ": unknown parameter " << name << endl;
+            continue;
+        }
+
+        char comma;
+        if (fields[i].integer != 0)
+            in >> *fields[i].integer;
+        else if (fields[i].real != 0)
+            in >> *fields[i].real;
+        else
+            in >> (*fields[i].scalar)[0] >> comma >> (*fields[i].scalar)[1] >> comma >> (*fields[i].scalar)[2];
+        if (!in)
+            cerr << fileName << ": wrong value in " << line << endl;
+    }
+    return true;
+}
+
+/** Write a profile.
+@param fileName - file
+@return - success
+*/
+bool DetectorParams::save(const string &fileName) const{
+    ofstream file(fileName.c_str());
+    if (!file){
+        cerr << "Could not write " << fileName << endl;
+        return false;
+    }
+
+    DetectorParams copy = *this;
+    vector<ParamField> fields = paramFields(copy);
+    for (size_t i = 0; i < fields.size(); i++){
+        file << fields[i].name << "=";
+        if (fields[i].integer != 0)
+            file << *fields[i].integer;
+        else if (fields[i].real != 0)
+            file << *fields[i].real;
+        else
+            file << (*fields[i].scalar)[0] << "," << (*fields[i].scalar)[1] << "," << (*fields[i].scalar)[2];
+        file << endl;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef DETECTORPARAMS_H_INCLUDED
+#define DETECTORPARAMS_H_INCLUDED
+#include <opencv2/imgproc/imgproc.hpp>
+#include <string>
+
+#define DETECTOR_PROFILE "/home/pi/detector.txt" /// Tuned detector parameters, loaded by each production Detector.
+
+using namespace cv;
+
+/** Ball detection algorithm.
+*/
+enum BallEngine {BALLS_HOUGH, BALLS_CONTOUR};
+
+/** All the detectors' tunable parameters in one place. Stored as a profile, a text file with "name=value" lines, for example
+"greenLow=40,0,40". Missing names keep their defaults.
+*/
+struct DetectorParams{
+    int cannyThreshold = 100; /// Canny's lower threshold for green contours, the upper one is double.
+    Scalar greenLow = Scalar(40, 0, 40); /// Green's HSV lower limits
+    Scalar greenHigh = Scalar(80, 255, 120); /// Green's HSV upper limits
+    int greenKernel = 5; /// Green's opening kernel, odd.
+    int blackMaximumV = 50; /// Black's HSV V upper limit
+    int yuvBlackMaximumY = 50; /// Black's Y upper limit, YUV pictures.
+    int yuvGreenMaximumU = 120; /// Green's U upper limit, YUV pictures. Gray and black are near 128.
+    int yuvGreenMaximumV = 120; /// Green's V upper limit, YUV pictures.
+    int blobAreaDivisor = 8000; /// A green blob can be a marker if its area is bigger than the cropped picture's area divided by this.
+    float blackFill = 0.5; /// A black-check area is black if more than this part is black.
+    Scalar ballLow = Scalar(0, 0, 60); /// Balls' HSV lower limits
+    Scalar ballHigh = Scalar(179, 255, 147); /// Balls' HSV upper limits
+    int ballKernel = 5; /// Balls' opening kernel, odd.
+    int ballEngine = BALLS_HOUGH; /// Ball detection algorithm, BallEngine: 0 Hough, 1 contour circularity.
+    int houghDistanceDivisor = 3; /// Hough: minimum distance between balls is picture's height divided by this.
+    int houghCanny = 100; /// Hough: Canny's upper threshold
+    int houghVotes = 20; /// Hough: accumulator threshold, less finds more (false) circles.
+    int houghMinimumRadius = 20; /// Hough: smallest ball
+    int houghMaximumRadius = 0; /// Hough: biggest ball, 0 for no limit.
+    int contourDistanceDivisor = 3; /// Contour: minimum distance between balls is picture's height divided by this.
+    int contourMinimumRadius = 20; /// Contour: smallest ball
+    float contourCircularity = 0.7; /// Contour: minimum circularity, 1 for a perfect circle.
+    float contourFill = 0.6; /// Contour: minimum part of the enclosing circle filled, 1 for a perfect circle.
+    int changeTile = 32; /// Change detection: tile's side, pixels.
+    int changeThreshold = 4; /// Change detection: a tile is dirty if its luminance changed more than this per pixel, on average.
+    int changeRefresh = 15; /// Change detection: all the tiles are processed every this many frames.
+
+    /** Read a profile.
+    @param fileName - file
+    @return - success
+    */
+    bool load(const std::string &fileName);
+
+    /** Write a profile.
+    @param fileName - file
+    @return - success
+    */
+    bool save(const std::string &fileName) const;
+};
+
+#endif // DETECTORPARAMS_H_INCLUDED
@@ -0,0 +1,119 @@
+#include "FloorMap.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#define FLOOR_LUT_SCALE 4 /// Table's units per mm
+#define FLOOR_VIEW_MAXIMUM 400 /// Bird's-eye view's maximum width and height
+
+using namespace std;
+using namespace cv;
+
+/** Load calibration and build the tables. The file contains 4 lines "point imageX imageY floorX floorY" (whole picture's pixels, floor mm)
+and optionally "cell mm", the bird's-eye view's resolution.
+@param fileName - calibration file
+@param roi - cropped part of the picture, the tables cover only it.
+@return - success
+*/
+bool FloorMap::load(const string &fileName, Rect roiNow){
+    ifstream file(fileName.c_str());
+    if (!file)
+        return false;
+
+    vector<Point2f> imagePoints, floorPoints;
+    float cellMm = 2;
+    string line;
+    while (getline(file, line)){
+        istringstream in(line);
+        string key;
+        in >> key;
+        if (key == "point"){
+            Point2f image, floor;
+            in >> image.x >> image.y >> floor.x >> floor.y;
+            imagePoints.push_back(image);
+            floorPoints.push_back(floor);
+        }
+        else if (key == "cell")
+            in >> cellMm;
+    }
+    if (imagePoints.size() != 4 || cellMm <= 0){
+        cerr << "Floor calibration " << fileName << " needs 4 points." << endl;
+        return false;
+    }
+
+    roi = roiNow;
+    Mat imageFloor = getPerspectiveTransform(imagePoints, floorPoints);
+    Mat floorImage = imageFloor.inv();
+    for (int i = 0; i < 9; i++){
+        imageToFloor[i] = imageFloor.at<double>(i / 3, i % 3);
+        floorToImage[i] = floorImage.at<double>(i / 3, i % 3);
+    }
+
+    /// Floor point of each cropped picture's pixel, fixed point.
+    lut.resize(roi.width * roi.height * 2);
+    float minimumX = 1e9, maximumX = -1e9, minimumY = 1e9, maximumY = -1e9;
+    for (int y = 0; y < roi.height; y++)
+        for (int x = 0; x < roi.width; x++){
+            Point2f floor = transform(imageToFloor, Point2f(x + roi.x, y + roi.y));
+            lut[(y * roi.width + x) * 2] = (int16_t)max(-32768.0f, min(32767.0f, floor.x * FLOOR_LUT_SCALE));
+            lut[(y * roi.width + x) * 2 + 1] = (int16_t)max(-32768.0f, min(32767.0f, floor.y * FLOOR_LUT_SCALE));
+            minimumX = min(minimumX, floor.x);
+            maximumX = max(maximumX, floor.x);
+            minimumY = min(minimumY, floor.y);
+            maximumY = max(maximumY, floor.y);
+        }
+
+    /// Bird's-eye view: for each cell, the pixel it comes from. Up is forward.
+    int width = min(FLOOR_VIEW_MAXIMUM, (int)((maximumX - minimumX) / cellMm) + 1);
+    int height = min(FLOOR_VIEW_MAXIMUM, (int)((maximumY - minimumY) / cellMm) + 1);
+    Mat mapX(height, width, CV_32FC1), mapY(height, width, CV_32FC1);
+    for (int v = 0; v < height; v++)
+        for (int u = 0; u < width; u++){
+            Point2f image = toImage(Point2f(minimumX + u * cellMm, maximumY - v * cellMm));
+            mapX.at<float>(v, u) = image.x;
+            mapY.at<float>(v, u) = image.y;
+        }
+    convertMaps(mapX, mapY, map1, map2, CV_16SC2);
+    return true;
+}
+
+/** Floor point of a picture's pixel, from the precomputed table.
+@param pixel - in the cropped picture
+@return - floor point, mm
+*/
+Point2f FloorMap::toFloor(Point pixel) const{
+    int x = max(0, min(roi.width - 1, pixel.x));
+    int y = max(0, min(roi.height - 1, pixel.y));
+    const int16_t *entry = &lut[(y * roi.width + x) * 2];
+    return Point2f((float)entry[0] / FLOOR_LUT_SCALE, (float)entry[1] / FLOOR_LUT_SCALE);
+}
+
+/** Picture's point of a floor point.
+@param floor - floor point, mm
+@return - point in the cropped picture
+*/
+Point2f FloorMap::toImage(Point2f floor) const{
+    Point2f image = transform(floorToImage, floor);
+    return Point2f(image.x - roi.x, image.y - roi.y);
+}
+
+/** Apply a homography.
+@param h - 3x3 matrix, row by row.
+@param point - point
+@return - transformed point
+*/
+Point2f FloorMap::transform(const double *h, Point2f point){
+    double w = h[6] * point.x + h[7] * point.y + h[8];
+    if (w == 0)
+        w = 1e-9;
+    return Point2f((h[0] * point.x + h[1] * point.y + h[2]) / w, (h[3] * point.x + h[4] * point.y + h[5]) / w);
+}
+
+/** Bird's-eye view of the cropped picture.
+@param roi - cropped picture
+@param floor - view. Up is forward.
+*/
+void FloorMap::warp(const Mat &roiImage, Mat &floor) const{
+    remap(roiImage, floor, map1, map2, INTER_LINEAR);
+}
@@ -0,0 +1,64 @@
+#ifndef FLOORMAP_H_INCLUDED
+#define FLOORMAP_H_INCLUDED
+#include <opencv2/imgproc/imgproc.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define FLOOR_CALIBRATION "/home/pi/floor.txt" /// Floor-plane calibration, loaded by each production Detector.
+
+using namespace cv;
+
+/** Inverse perspective mapping between the cropped picture and the floor plane (bird's-eye view). Floor coordinates are in mm: x to the right,
+y forward. All the tables are computed once, from a calibration file; afterwards each point costs a lookup and the whole view a single remap.
+*/
+class FloorMap{
+    public:
+        /** Load calibration and build the tables. The file contains 4 lines "point imageX imageY floorX floorY" (whole picture's pixels, floor mm)
+        and optionally "cell mm", the bird's-eye view's resolution.
+        @param fileName - calibration file
+        @param roi - cropped part of the picture, the tables cover only it.
+        @return - success
+        */
+        bool load(const std::string &fileName, Rect roi);
+
+        /** Floor point of a picture's pixel, from the precomputed table.
+        @param pixel - in the cropped picture
+        @return - floor point, mm
+        */
+        Point2f toFloor(Point pixel) const;
+
+        /** Picture's point of a floor point.
+        @param floor - floor point, mm
+        @return - point in the cropped picture
+        */
+        Point2f toImage(Point2f floor) const;
+
+        /** Calibration loaded.
+        @return - valid
+        */
+        bool valid() const{ return !lut.empty();}
+
+        /** Bird's-eye view of the cropped picture.
+        @param roi - cropped picture
+        @param floor - view. Up is forward.
+        */
+        void warp(const Mat &roi, Mat &floor) const;
+
+    private:
+        double floorToImage[9]; /// Homography, floor to whole picture
+        double imageToFloor[9]; /// Homography, whole picture to floor
+        std::vector<int16_t> lut; /// For each cropped picture's pixel: floor x, y in 1/4 mm
+        Mat map1; /// Remap table, fixed point coordinates
+        Mat map2; /// Remap table, interpolation weights
+        Rect roi; /// Cropped part of the picture
+
+        /** Apply a homography.
+        @param h - 3x3 matrix, row by row.
+        @param point - point
+        @return - transformed point
+        */
+        static Point2f transform(const double *h, Point2f point);
+};
+
+#endif // FLOORMAP_H_INCLUDED
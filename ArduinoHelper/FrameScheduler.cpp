@@ -0,0 +1,106 @@
+#include "FrameScheduler.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <iostream>
+#include <wiringPi.h>
+
+#define SCHEDULER_SKIP_DECAY 0.9 /// A skipped stage's usual time shrinks by this factor, so it runs again, as a probe, after a slow spell.
+
+using namespace std;
+
+/** Constructor
+@param budgetMs - time from capture to the end of processing.
+@param maximumAgeMs - frames older than this when processing should start are dropped.
+*/
+FrameScheduler::FrameScheduler(uint32_t budget, uint32_t maximumAge){
+    budgetMs = budget;
+    maximumAgeMs = maximumAge;
+}
+
+/** Start processing a frame.
+@param captureMs - capture time, millis()
+@return - process it, false if too old.
+*/
+bool FrameScheduler::frameBegin(uint32_t captureMs){
+    if (millis() - captureMs > maximumAgeMs){
+        framesDropped++;
+        Metrics::add(METRIC_FRAMES_DROPPED);
+        return false;
+    }
+    deadlineMs = captureMs + budgetMs;
+    for (size_t i = 0; i < stages.size(); i++)
+        stages[i].done = false;
+    return true;
+}
+
+/** Frame processed.
+*/
+void FrameScheduler::frameEnd(){
+    framesProcessed++;
+    if ((int32_t)(millis() - deadlineMs) > 0){
+        framesLate++;
+        Metrics::add(METRIC_FRAMES_LATE);
+    }
+}
+
+/** Print statistics.
+*/
+void FrameScheduler::report(){
+    cout << "Frames: " << framesProcessed << " processed, " << framesLate << " late, " << framesDropped << " dropped." << endl;
+    for (size_t i = 0; i < stages.size(); i++)
+        cout << "  " << stages[i].name << ": " << stages[i].averageMs << " ms, " << stages[i].runs << " runs, " << stages[i].skipped <<
+            " skipped, " << stages[i].misses << " deadline misses." << endl;
+}
+
+/** Add a stage.
+@param name - stage's name
+@param optional - can be skipped
+@param parallelTo - required stage this one runs alongside, its time then counts only beyond that stage's. -1 if sequential.
+@return - stage's index
+*/
+int FrameScheduler::stageAdd(const string &name, bool optional, int parallelTo){
+    Stage stage = {name, optional, parallelTo, 0, false, 0, 0, 0};
+    stages.push_back(stage);
+    return stages.size() - 1;
+}
+
+/** Should a stage run? Required stages always do, optional ones only if the frame's critical path, estimated from usual times, still
+fits into the time left for this frame. A skipped stage's usual time decays, so it is tried again once in a while.
+@param stage - stage's index
+@return - run it
+*/
+bool FrameScheduler::stageAllowed(int stage){
+    if (!stages[stage].optional)
+        return true;
+
+    /// Critical path: the required stages not done yet in this frame run one after another. A sequential stage adds its time, a parallel
+    /// one replaces its partner's time if it is longer. The partner's usual time already includes the frames it ran alongside.
+    double requiredMs = 0;
+    for (size_t i = 0; i < stages.size(); i++)
+        if (!stages[i].optional && !stages[i].done)
+            requiredMs += stages[i].averageMs;
+    const Stage &current = stages[stage];
+    double neededMs = requiredMs + current.averageMs;
+    if (current.parallelTo >= 0 && !stages[current.parallelTo].done)
+        neededMs = requiredMs + max(0.0, current.averageMs - stages[current.parallelTo].averageMs);
+    int32_t leftMs = deadlineMs - millis();
+    if (leftMs < neededMs){
+        stages[stage].skipped++;
+        stages[stage].averageMs *= SCHEDULER_SKIP_DECAY; /// Otherwise one slow run could keep it skipped forever.
+        return false;
+    }
+    return true;
+}
+
+/** Stage finished: update its usual time and count a deadline miss, if it happened.
+@param stage - stage's index
+@param ms - time the stage took
+*/
+void FrameScheduler::stageDone(int stage, double ms){
+    Stage &current = stages[stage];
+    current.averageMs = current.runs == 0 ? ms : current.averageMs * 0.9 + ms * 0.1;
+    current.runs++;
+    current.done = true;
+    if ((int32_t)(millis() - deadlineMs) > 0)
+        current.misses++;
+}
@@ -0,0 +1,76 @@
+#ifndef FRAMESCHEDULER_H_INCLUDED
+#define FRAMESCHEDULER_H_INCLUDED
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Gives each frame a deadline, measured from its capture time. Frames already too old are dropped and optional stages are skipped when the
+remaining time is too short for them. Acting on fresh data with a reduced result is better than acting on perfect, old data.
+*/
+class FrameScheduler{
+    public:
+        /** Constructor
+        @param budgetMs - time from capture to the end of processing.
+        @param maximumAgeMs - frames older than this when processing should start are dropped.
+        */
+        FrameScheduler(uint32_t budgetMs = 33, uint32_t maximumAgeMs = 50);
+
+        /** Start processing a frame.
+        @param captureMs - capture time, millis()
+        @return - process it, false if too old.
+        */
+        bool frameBegin(uint32_t captureMs);
+
+        /** Frame processed.
+        */
+        void frameEnd();
+
+        /** Print statistics.
+        */
+        void report();
+
+        /** Add a stage.
+        @param name - stage's name
+        @param optional - can be skipped
+        @param parallelTo - required stage this one runs alongside, its time then counts only beyond that stage's. -1 if sequential.
+        @return - stage's index
+        */
+        int stageAdd(const std::string &name, bool optional, int parallelTo = -1);
+
+        /** Should a stage run? Required stages always do, optional ones only if the frame's critical path, estimated from usual times, still
+        fits into the time left for this frame. A skipped stage's usual time decays, so it is tried again once in a while.
+        @param stage - stage's index
+        @return - run it
+        */
+        bool stageAllowed(int stage);
+
+        /** Stage finished: update its usual time and count a deadline miss, if it happened.
+        @param stage - stage's index
+        @param ms - time the stage took
+        */
+        void stageDone(int stage, double ms);
+
+    private:
+        /** Statistics of a stage.
+        */
+        struct Stage{
+            std::string name; /// Stage's name
+            bool optional; /// Can be skipped
+            int parallelTo; /// Required stage it runs alongside, -1 if sequential
+            double averageMs; /// Usual time, exponentially weighted average, decaying while skipped
+            bool done; /// Done in the current frame
+            uint32_t runs; /// Times executed
+            uint32_t skipped; /// Times skipped because of the deadline
+            uint32_t misses; /// Finished after the deadline
+        };
+
+        uint32_t budgetMs; /// Time from capture to the end of processing
+        uint32_t deadlineMs = 0; /// Current frame's deadline, millis()
+        uint32_t framesDropped = 0; /// Too old to be processed
+        uint32_t framesLate = 0; /// Processed, but after the deadline
+        uint32_t framesProcessed = 0; /// Processed
+        uint32_t maximumAgeMs; /// Frames older than this are dropped
+        std::vector<Stage> stages; /// Stages, in order of addition
+};
+
+#endif // FRAMESCHEDULER_H_INCLUDED
@@ -0,0 +1,65 @@
+#include "IntegralImage.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+/** Build the table.
+@param mask - picture
+*/
+void IntegralImage::build(const BinaryMask &mask){
+    rows = mask.rows;
+    cols = mask.cols;
+    const int stride = cols + 1;
+    sums.assign((size_t)(rows + 1) * stride, 0);
+
+    for (int y = 0; y < rows; y++){
+        const uint64_t *bits = mask.row(y);
+        const uint32_t *above = &sums[(size_t)y * stride];
+        uint32_t *current = &sums[(size_t)(y + 1) * stride];
+        uint32_t rowSum = 0;
+        for (int x = 0; x < cols; x++){
+            rowSum += (bits[x >> 6] >> (x & 63)) & 1;
+            current[x + 1] = above[x + 1] + rowSum;
+        }
+    }
+}
+
+/** Clip to the picture.
+@param region - rectangle
+@return - clipped rectangle, may be empty.
+*/
+Rect IntegralImage::clip(Rect region) const{
+    int x0 = max(region.x, 0);
+    int y0 = max(region.y, 0);
+    int x1 = min(region.x + region.width, cols);
+    int y1 = min(region.y + region.height, rows);
+    if (x1 <= x0 || y1 <= y0)
+        return Rect(0, 0, 0, 0);
+    return Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/** Number of set pixels.
+@param region - rectangle, clipped to the picture.
+@return - count
+*/
+uint32_t IntegralImage::count(Rect region) const{
+    region = clip(region);
+    if (region.width == 0)
+        return 0;
+    const int stride = cols + 1;
+    int x0 = region.x, y0 = region.y, x1 = region.x + region.width, y1 = region.y + region.height;
+    return sums[y1 * stride + x1] - sums[y0 * stride + x1] - sums[y1 * stride + x0] + sums[y0 * stride + x0];
+}
+
+/** Part of the rectangle that is set.
+@param region - rectangle, clipped to the picture.
+@param minimumInside - if less than this part of the rectangle is inside the picture, the result is 0.
+@return - 0 (none) to 1 (all).
+*/
+float IntegralImage::fill(Rect region, float minimumInside) const{
+    Rect inside = clip(region);
+    if (inside.width == 0 || inside.area() < region.area() * minimumInside)
+        return 0;
+    return (float)count(inside) / inside.area();
+}
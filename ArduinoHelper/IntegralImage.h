@@ -0,0 +1,42 @@
+#ifndef INTEGRALIMAGE_H_INCLUDED
+#define INTEGRALIMAGE_H_INCLUDED
+#include "BinaryMask.h"
+#include <stdint.h>
+#include <vector>
+
+/** Summed-area table of a BinaryMask. Built once per frame, afterwards the number of set pixels in any rectangle is known in constant time.
+*/
+class IntegralImage{
+    public:
+        /** Build the table.
+        @param mask - picture
+        */
+        void build(const BinaryMask &mask);
+
+        /** Number of set pixels.
+        @param region - rectangle, clipped to the picture.
+        @return - count
+        */
+        uint32_t count(Rect region) const;
+
+        /** Part of the rectangle that is set.
+        @param region - rectangle, clipped to the picture.
+        @param minimumInside - if less than this part of the rectangle is inside the picture, the result is 0.
+        @return - 0 (none) to 1 (all).
+        */
+        float fill(Rect region, float minimumInside = 0.5) const;
+
+        int cols = 0; /// Width
+        int rows = 0; /// Height
+
+    private:
+        std::vector<uint32_t> sums; /// (rows + 1) x (cols + 1) sums, first row and column are 0.
+
+        /** Clip to the picture.
+        @param region - rectangle
+        @return - clipped rectangle, may be empty.
+        */
+        Rect clip(Rect region) const;
+};
+
+#endif // INTEGRALIMAGE_H_INCLUDED
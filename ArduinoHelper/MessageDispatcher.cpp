@@ -0,0 +1,117 @@
+#include "MessageDispatcher.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+/** Constructor
+*/
+MessageDispatcher::MessageDispatcher(){
+    memset(payloadSizes, 0, sizeof(payloadSizes));
+    memset(unknown, 0, sizeof(unknown));
+}
+
+/** Register a message.
+@param id - message's id, its first byte.
+@param payloadSize - bytes after the id
+@param handler - called for each message
+*/
+void MessageDispatcher::add(uint8_t id, uint8_t payloadSize, Handler handler){
+    handlers[id] = handler;
+    payloadSizes[id] = payloadSize;
+}
+
+/** Read all the available bytes and dispatch all the complete messages. An incomplete one waits for the rest.
+@param uart - serial port
+@param verbose - print each message
+@return - number of messages dispatched
+*/
+int MessageDispatcher::dispatch(UART &uart, bool verbose){
+    int dispatched = 0;
+    bool full;
+    do{
+        while (pendingCount < DISPATCH_BUFFER_SIZE && uart.available()){ /// In bulk, not a system call per byte.
+            int count = uart.read(min(DISPATCH_BUFFER_SIZE - pendingCount, (size_t)255), pending + pendingCount);
+            if (count <= 0)
+                break;
+            pendingCount += count;
+        }
+        full = pendingCount == DISPATCH_BUFFER_SIZE;
+        dispatched += dispatchPending(verbose);
+    } while (full); /// The buffer was full, more bytes may be waiting.
+    if (dispatched > 0)
+        Metrics::add(METRIC_UART_RX_MESSAGES, dispatched);
+    return dispatched;
+}
+
+/** Dispatch bytes already read, for example in a check. An incomplete message waits for the rest.
+@param bytes - inbound bytes
+@param count - number of bytes
+@param verbose - print each message
+@return - number of messages dispatched
+*/
+int MessageDispatcher::dispatch(const uint8_t *bytes, size_t count, bool verbose){
+    int dispatched = 0;
+    while (count > 0){
+        size_t chunk = min(DISPATCH_BUFFER_SIZE - pendingCount, count);
+        memcpy(pending + pendingCount, bytes, chunk);
+        pendingCount += chunk;
+        bytes += chunk;
+        count -= chunk;
+        dispatched += dispatchPending(verbose);
+    }
+    if (dispatched > 0)
+        Metrics::add(METRIC_UART_RX_MESSAGES, dispatched);
+    return dispatched;
+}
+
+/** Dispatch all the complete pending messages and keep the incomplete one.
+@param verbose - print each message
+@return - number of messages dispatched
+*/
+int MessageDispatcher::dispatchPending(bool verbose){
+    int dispatched = 0;
+    size_t position = 0;
+    while (position < pendingCount){
+        uint8_t id = pending[position];
+        if (!handlers[id]){ /// Not a message's start: count it and resynchronize on the next byte.
+            unknown[id]++;
+            unknownTotal++;
+            Metrics::add(METRIC_UART_UNKNOWN);
+            if (verbose)
+                cerr << "Unknown message id " << (int)id << endl;
+            position++;
+            continue;
+        }
+        if (pendingCount - position < 1u + payloadSizes[id])
+            break; /// The rest has not arrived yet.
+
+        if (verbose)
+            cout << "Inbound message '" << (char)id << "', " << (int)payloadSizes[id] << " bytes of payload." << endl;
+        handlers[id](&pending[position + 1]);
+        position += 1 + payloadSizes[id];
+        dispatched++;
+    }
+
+    /// Keep the incomplete message for the next call.
+    memmove(pending, pending + position, pendingCount - position);
+    pendingCount -= position;
+    return dispatched;
+}
+
+/** Print unknown ids' counters.
+*/
+void MessageDispatcher::report(){
+    if (unknownTotal == 0)
+        return;
+    cout << "Unknown inbound bytes: " << unknownTotal << " (";
+    bool first = true;
+    for (int id = 0; id < 256; id++)
+        if (unknown[id] != 0){
+            cout << (first ? "" : ", ") << id << ": " << unknown[id];
+            first = false;
+        }
+    cout << ")." << endl;
+}
@@ -0,0 +1,70 @@
+#ifndef MESSAGEDISPATCHER_H_INCLUDED
+#define MESSAGEDISPATCHER_H_INCLUDED
+#include "UART.h"
+#include <functional>
+#include <stdint.h>
+
+#define DISPATCH_BUFFER_SIZE 256 /// Inbound bytes waiting to be dispatched. Holds the biggest message: id and 255 bytes of payload.
+
+/** Inbound messages' dispatcher. A message is its id byte followed by a fixed-size payload, the size given by the id. Handlers are found in a
+table indexed by the id, in constant time. All the queued messages are dispatched in one batch. Unknown ids are counted and skipped, one byte
+at a time, until a known id appears again.
+*/
+class MessageDispatcher{
+    public:
+        /** Handler
+        @param payload - message's bytes after the id
+        */
+        typedef std::function<void(const uint8_t *payload)> Handler;
+
+        /** Constructor
+        */
+        MessageDispatcher();
+
+        /** Register a message.
+        @param id - message's id, its first byte.
+        @param payloadSize - bytes after the id
+        @param handler - called for each message
+        */
+        void add(uint8_t id, uint8_t payloadSize, Handler handler);
+
+        /** Read all the available bytes and dispatch all the complete messages. An incomplete one waits for the rest.
+        @param uart - serial port
+        @param verbose - print each message
+        @return - number of messages dispatched
+        */
+        int dispatch(UART &uart, bool verbose = false);
+
+        /** Dispatch bytes already read, for example in a check. An incomplete message waits for the rest.
+        @param bytes - inbound bytes
+        @param count - number of bytes
+        @param verbose - print each message
+        @return - number of messages dispatched
+        */
+        int dispatch(const uint8_t *bytes, size_t count, bool verbose = false);
+
+        /** Print unknown ids' counters.
+        */
+        void report();
+
+        /** All unknown bytes so far.
+        @return - count
+        */
+        uint32_t unknownCount() const{ return unknownTotal;}
+
+    private:
+        /** Dispatch all the complete pending messages and keep the incomplete one.
+        @param verbose - print each message
+        @return - number of messages dispatched
+        */
+        int dispatchPending(bool verbose);
+
+        Handler handlers[256]; /// By id. Empty for unknown ids.
+        uint8_t payloadSizes[256]; /// By id
+        uint8_t pending[DISPATCH_BUFFER_SIZE]; /// Bytes read but not yet dispatched
+        size_t pendingCount = 0; /// Number of pending bytes
+        uint32_t unknown[256]; /// Unknown bytes by value
+        uint32_t unknownTotal = 0; /// All unknown bytes
+};
+
+#endif // MESSAGEDISPATCHER_H_INCLUDED
@@ -0,0 +1,150 @@
+#include "Metrics.h"
+#include <iostream>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define METRICS_POLL_MS 200 /// Server checks for stopping this often.
+
+using namespace std;
+
+const char *Metrics::names[METRIC_COUNT] = {"frames.captured", "frames.processed", "frames.dropped", "frames.late", "frames.fps",
+    "changes.frames_reused", "changes.dirty_tiles",
+    "detector.crossing_us", "detector.circles_us", "detector.detect_all_us", "detector.balls_us",
+    "detections.marker",
+    "uart.rx_bytes", "uart.tx_bytes", "uart.rx_messages", "uart.tx_messages", "uart.unknown_bytes",
+    "robot.state"};
+atomic<const char*> Metrics::stateName(0);
+atomic<int64_t> Metrics::values[METRIC_COUNT];
+
+/** Socket's address.
+@param path - socket's path
+@param address - address for bind() or connect()
+@return - path fits.
+*/
+static bool metricsAddress(const string &path, sockaddr_un &address){
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    strcpy(address.sun_path, path.c_str());
+    return true;
+}
+
+/** Query a server and return its metrics.
+@param socketName - server's socket
+@param text - metrics, a "name value" line each.
+@return - server answered.
+*/
+bool Metrics::query(const string &socketName, string &text){
+    sockaddr_un address;
+    if (!metricsAddress(socketName, address))
+        return false;
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client < 0)
+        return false;
+    if (connect(client, (sockaddr*)&address, sizeof(address)) != 0){
+        close(client);
+        return false;
+    }
+    text.clear();
+    char buffer[1024];
+    ssize_t count;
+    while ((count = ::read(client, buffer, sizeof(buffer))) > 0)
+        text.append(buffer, count);
+    close(client);
+    return true;
+}
+
+/** All the metrics as text.
+@return - a "name value" line each. The state gauge is followed by the state's name.
+*/
+string Metrics::snapshot(){
+    string text;
+    char line[128];
+    for (int i = 0; i < METRIC_COUNT; i++){
+        snprintf(line, sizeof(line), "%s %lld", names[i], (long long)get((Metric)i));
+        text += line;
+        if (i == METRIC_STATE && stateName.load() != 0)
+            text += string(" ") + stateName.load();
+        text += "\n";
+    }
+    return text;
+}
+
+/** Set the state gauge.
+@param state - state's number
+@param name - state's name, must not be freed.
+*/
+void Metrics::stateSet(int state, const char *name){
+    stateName = name;
+    set(METRIC_STATE, state);
+}
+
+/** Constructor
+*/
+MetricsServer::MetricsServer(){
+    serving = false;
+}
+
+/** Destructor, stops serving.
+*/
+MetricsServer::~MetricsServer(){
+    stop();
+}
+
+/** Server thread's loop.
+*/
+void MetricsServer::loop(){
+    pollfd listening = {listener, POLLIN, 0};
+    while (serving){
+        if (poll(&listening, 1, METRICS_POLL_MS) <= 0)
+            continue;
+        int client = accept(listener, 0, 0);
+        if (client < 0)
+            continue;
+        string text = Metrics::snapshot();
+        if (::write(client, text.data(), text.size()) < 0)
+            perror("Metrics error.");
+        close(client);
+    }
+}
+
+/** Create the socket and start serving.
+@param socketName - socket's path. A stale one is replaced.
+@return - success
+*/
+bool MetricsServer::start(const string &socketName){
+    stop();
+    sockaddr_un address;
+    if (!metricsAddress(socketName, address) || (listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0){
+        cerr << "Metrics socket error." << endl;
+        return false;
+    }
+    unlink(socketName.c_str()); /// Left by a previous, killed instance
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4) != 0){
+        perror("Metrics socket error.");
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    socketPath = socketName;
+    serving = true;
+    server = thread(&MetricsServer::loop, this);
+    return true;
+}
+
+/** Stop serving and remove the socket.
+*/
+void MetricsServer::stop(){
+    if (!serving)
+        return;
+    serving = false;
+    server.join();
+    close(listener);
+    listener = -1;
+    unlink(socketPath.c_str());
+}
@@ -0,0 +1,108 @@
+#ifndef METRICS_H_INCLUDED
+#define METRICS_H_INCLUDED
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+#define METRICS_SOCKET "/tmp/mrms-metrics-" /// Unix socket's path prefix, followed by the serving state's name and ".sock"
+
+/** Counters (only growing) and gauges (last value) of the running program.
+*/
+enum Metric {
+    /// Frames
+    METRIC_FRAMES_CAPTURED, METRIC_FRAMES_PROCESSED, METRIC_FRAMES_DROPPED, METRIC_FRAMES_LATE, METRIC_FPS,
+    /// Change detection: frames whose results were reused, last frame's dirty tiles
+    METRIC_FRAMES_REUSED, METRIC_TILES_DIRTY,
+    /// Detectors' last times, microseconds
+    METRIC_CROSSING_US, METRIC_CIRCLES_US, METRIC_DETECT_ALL_US, METRIC_BALLS_US,
+    /// Detections
+    METRIC_MARKER,
+    /// UART
+    METRIC_UART_RX_BYTES, METRIC_UART_TX_BYTES, METRIC_UART_RX_MESSAGES, METRIC_UART_TX_MESSAGES, METRIC_UART_UNKNOWN,
+    /// Robot
+    METRIC_STATE,
+    METRIC_COUNT /// Number of metrics, not a metric
+};
+
+/** Process-wide registry of metrics. Updating one is a single relaxed atomic operation, so hot loops count and measure without any stream
+I/O. MetricsServer serves them on request, "ArduinoHelper METRICS" shows them.
+*/
+class Metrics{
+    public:
+        /** Increase a counter.
+        @param metric - counter
+        @param value - increment
+        */
+        static void add(Metric metric, int64_t value = 1){ values[metric].fetch_add(value, std::memory_order_relaxed);}
+
+        /** Current value.
+        @param metric - counter or gauge
+        @return - value
+        */
+        static int64_t get(Metric metric){ return values[metric].load(std::memory_order_relaxed);}
+
+        /** Query a server and return its metrics.
+        @param socketName - server's socket
+        @param text - metrics, a "name value" line each.
+        @return - server answered.
+        */
+        static bool query(const std::string &socketName, std::string &text);
+
+        /** Set a gauge.
+        @param metric - gauge
+        @param value - new value
+        */
+        static void set(Metric metric, int64_t value){ values[metric].store(value, std::memory_order_relaxed);}
+
+        /** All the metrics as text.
+        @return - a "name value" line each. The state gauge is followed by the state's name.
+        */
+        static std::string snapshot();
+
+        /** Set the state gauge.
+        @param state - state's number
+        @param name - state's name, must not be freed.
+        */
+        static void stateSet(int state, const char *name);
+
+    private:
+        static const char *names[METRIC_COUNT]; /// In Metric's order
+        static std::atomic<const char*> stateName; /// Current state's name
+        static std::atomic<int64_t> values[METRIC_COUNT]; /// In Metric's order
+};
+
+/** Serves Metrics::snapshot() to each client connecting to a local Unix-domain socket, from a background thread.
+*/
+class MetricsServer{
+    public:
+        /** Constructor
+        */
+        MetricsServer();
+
+        /** Destructor, stops serving.
+        */
+        ~MetricsServer();
+
+        /** Create the socket and start serving.
+        @param socketName - socket's path. A stale one is replaced.
+        @return - success
+        */
+        bool start(const std::string &socketName);
+
+        /** Stop serving and remove the socket.
+        */
+        void stop();
+
+    private:
+        int listener = -1; /// Listening socket
+        std::thread server; /// Answers clients
+        std::atomic<bool> serving; /// Server continues
+        std::string socketPath; /// Socket's path
+
+        /** Server thread's loop.
+        */
+        void loop();
+};
+
+#endif // METRICS_H_INCLUDED
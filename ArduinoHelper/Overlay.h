@@ -0,0 +1,75 @@
+#ifndef OVERLAY_H_INCLUDED
+#define OVERLAY_H_INCLUDED
+#include <opencv2/imgproc/imgproc.hpp>
+#include <vector>
+
+using namespace cv;
+
+/** One drawing primitive, describing what a detector found. Detectors only list them, Viewer draws them later in its own thread.
+*/
+struct OverlayItem{
+    enum Type {CIRCLE, POLYGON, TEXT};
+
+    Type type; /// Primitive
+    Point position; /// Circle's centre or text's origin
+    int radius; /// Circle's radius
+    const char *text; /// Text, a literal.
+    std::vector<Point> points; /// Polygon's vertices
+    Scalar color; /// BGR
+    int thickness; /// Line thickness
+};
+
+/** All the primitives for one picture.
+*/
+typedef std::vector<OverlayItem> Overlay;
+
+/** Add a circle.
+@param overlay - list
+@param centre - circle's centre
+@param radius - circle's radius
+@param color - BGR
+@param thickness - line thickness
+*/
+inline void overlayCircle(Overlay &overlay, Point centre, int radius, Scalar color, int thickness = 1){
+    OverlayItem item = {OverlayItem::CIRCLE, centre, radius, 0, std::vector<Point>(), color, thickness};
+    overlay.push_back(item);
+}
+
+/** Add a closed polygon, for example a contour.
+@param overlay - list
+@param points - vertices
+@param color - BGR
+@param thickness - line thickness
+*/
+inline void overlayPolygon(Overlay &overlay, const std::vector<Point> &points, Scalar color, int thickness = 1){
+    OverlayItem item = {OverlayItem::POLYGON, Point(), 0, 0, points, color, thickness};
+    overlay.push_back(item);
+}
+
+/** Add a rectangle's outline.
+@param overlay - list
+@param region - rectangle
+@param color - BGR
+@param thickness - line thickness
+*/
+inline void overlayRectangle(Overlay &overlay, Rect region, Scalar color, int thickness = 1){
+    std::vector<Point> corners;
+    corners.push_back(region.tl());
+    corners.push_back(Point(region.x + region.width - 1, region.y));
+    corners.push_back(region.br() - Point(1, 1));
+    corners.push_back(Point(region.x, region.y + region.height - 1));
+    overlayPolygon(overlay, corners, color, thickness);
+}
+
+/** Add a text.
+@param overlay - list
+@param origin - bottom-left corner of the text
+@param text - a literal, it is not copied.
+@param color - BGR
+*/
+inline void overlayText(Overlay &overlay, Point origin, const char *text, Scalar color){
+    OverlayItem item = {OverlayItem::TEXT, origin, 0, text, std::vector<Point>(), color, 1};
+    overlay.push_back(item);
+}
+
+#endif // OVERLAY_H_INCLUDED
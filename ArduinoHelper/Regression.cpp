@@ -0,0 +1,350 @@
+#include "Regression.h"
+#include <algorithm>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <math.h>
+#include <opencv2/highgui/highgui.hpp>
+#include <sstream>
+#include <thread>
+#include <wiringPi.h>
+
+using namespace std;
+using namespace cv;
+
+/** Constructor
+@param directory - directory with recorded pictures.
+@param thresh - Canny threshold.
+*/
+Regression::Regression(string directoryNow, int threshold){
+    directory = directoryNow;
+    if (!directory.empty() && directory[directory.size() - 1] != '/')
+        directory += '/';
+    thresh = threshold;
+}
+
+/** Compare current results with ground truth of synthetic pictures and print accuracy.
+@return - accuracy
+*/
+SceneScore Regression::accuracy(){
+    SceneScore score;
+    for (size_t i = 0; i < frames.size(); i++)
+        score.add(frames[i].detections, frames[i].truth);
+    score.print();
+    return score;
+}
+
+/** Compare current results with golden ones and print differences.
+@param golden - golden results
+@return - detections are the same.
+*/
+bool Regression::compare(const vector<Frame> &golden){
+    const float ballTolerance = 1; /// Pixels
+
+    map<string, const Detections*> goldenByName;
+    for (size_t i = 0; i < golden.size(); i++)
+        goldenByName[golden[i].name] = &golden[i].detections;
+
+    uint32_t missing = 0, markersChanged = 0, blobsChanged = 0, ballsChanged = 0;
+    double goldenMs = 0, currentMs = 0;
+    uint32_t compared = 0;
+    for (size_t i = 0; i < frames.size(); i++){
+        map<string, const Detections*>::iterator it = goldenByName.find(frames[i].name);
+        if (it == goldenByName.end()){
+            missing++;
+            continue;
+        }
+        const Detections &was = *it->second;
+        const Detections &now = frames[i].detections;
+        compared++;
+        goldenMs += was.ms;
+        currentMs += now.ms;
+
+        if (was.marker != now.marker){
+            markersChanged++;
+            cout << frames[i].name << ": marker " << was.marker << " -> " << now.marker << endl;
+        }
+
+        bool same = was.blobs.size() == now.blobs.size();
+        for (size_t j = 0; same && j < now.blobs.size(); j++)
+            same = was.blobs[j].centre == now.blobs[j].centre;
+        if (!same){
+            blobsChanged++;
+            cout << frames[i].name << ": blobs " << was.blobs.size() << " -> " << now.blobs.size() << endl;
+        }
+
+        same = was.balls.size() == now.balls.size();
+        for (size_t j = 0; same && j < now.balls.size(); j++)
+            same = fabs(was.balls[j].centre.x - now.balls[j].centre.x) <= ballTolerance &&
+                fabs(was.balls[j].centre.y - now.balls[j].centre.y) <= ballTolerance &&
+                fabs(was.balls[j].radius - now.balls[j].radius) <= ballTolerance;
+        if (!same){
+            ballsChanged++;
+            cout << frames[i].name << ": balls " << was.balls.size() << " -> " << now.balls.size() << endl;
+        }
+    }
+
+    /// Accuracy
+    cout << "Compared " << compared << " pictures, " << missing << " not in golden results, " << (golden.size() - compared) << " golden ones missing." << endl;
+    cout << "Changed: " << markersChanged << " markers, " << blobsChanged << " blobs, " << ballsChanged << " balls." << endl;
+
+    /// Speed
+    if (compared > 0){
+        goldenMs /= compared;
+        currentMs /= compared;
+        cout << "Speed: " << goldenMs << " ms -> " << currentMs << " ms per picture";
+        if (goldenMs > 0)
+            cout << " (" << round((currentMs - goldenMs) / goldenMs * 100) << "%)";
+        cout << "." << endl;
+    }
+
+    return missing == 0 && compared == golden.size() && markersChanged == 0 && blobsChanged == 0 && ballsChanged == 0;
+}
+
+/** Compare ball detection algorithms: speed and agreement with Hough.
+*/
+void Regression::compareBallEngines(){
+    double houghMs = 0, contourMs = 0, errorSum = 0;
+    uint32_t agree = 0, matched = 0;
+    for (size_t i = 0; i < frames.size(); i++){
+        const vector<Ball> &hough = frames[i].detections.balls;
+        const vector<Ball> &contour = frames[i].contourBalls.balls;
+        houghMs += frames[i].houghMs;
+        contourMs += frames[i].contourBalls.ms;
+
+        /// Each Hough ball should have a contour ball nearer than a quarter of its radius.
+        bool same = hough.size() == contour.size();
+        for (size_t j = 0; same && j < hough.size(); j++){
+            float nearest = -1;
+            for (size_t k = 0; k < contour.size(); k++){
+                float distance = hypot(hough[j].centre.x - contour[k].centre.x, hough[j].centre.y - contour[k].centre.y);
+                if (nearest < 0 || distance < nearest)
+                    nearest = distance;
+            }
+            same = nearest <= max(2.0f, hough[j].radius / 4);
+            if (same){
+                errorSum += nearest;
+                matched++;
+            }
+        }
+        if (same)
+            agree++;
+    }
+
+    if (frames.empty())
+        return;
+    cout << "Balls: Hough " << houghMs / frames.size() << " ms, contour " << contourMs / frames.size() << " ms per picture. Agree in " <<
+        agree << " of " << frames.size() << " pictures";
+    if (matched > 0)
+        cout << ", mean centre difference " << errorSum / matched << " px";
+    cout << "." << endl;
+}
+
+/** Find all the pictures in the directory.
+@return - success
+*/
+bool Regression::list(){
+    DIR *dir;
+    struct dirent *ent;
+    if ((dir = opendir(directory.c_str())) == NULL){
+        perror("Directory error.");
+        return false;
+    }
+
+    frames.clear();
+    while ((ent = readdir(dir)) != NULL){
+        string name = ent->d_name;
+        size_t dot = name.rfind('.');
+        if (dot == string::npos)
+            continue;
+        string extension = name.substr(dot + 1);
+        if (extension == "png" || extension == "jpg" || extension == "bmp"){
+            Frame frame;
+            frame.name = name;
+            frames.push_back(frame);
+        }
+    }
+    closedir(dir);
+
+    sort(frames.begin(), frames.end(), [](const Frame &a, const Frame &b){ return a.name < b.name;});
+    return true;
+}
+
+/** Process all the frames on all the cores and print speed.
+*/
+void Regression::process(){
+    /// All the cores work, each one with its own Detector.
+    uint32_t startMs = millis();
+    nextFrame = 0;
+    unsigned workerCount = max(1u, thread::hardware_concurrency());
+    vector<thread> workers;
+    for (unsigned i = 0; i < workerCount; i++)
+        workers.push_back(thread(&Regression::work, this));
+    for (unsigned i = 0; i < workerCount; i++)
+        workers[i].join();
+    uint32_t elapsedMs = millis() - startMs;
+
+    cout << frames.size() << " pictures in " << elapsedMs << " ms using " << workerCount << " cores";
+    if (elapsedMs > 0)
+        cout << ", " << round(frames.size() * 1000.0 / elapsedMs) << " pictures/s";
+    cout << "." << endl;
+}
+
+/** Read results.
+@param fileName - file
+@param results - results read
+@return - success
+*/
+bool Regression::read(string fileName, vector<Frame> &results){
+    ifstream file(fileName.c_str());
+    if (!file)
+        return false;
+
+    results.clear();
+    string line;
+    while (getline(file, line)){
+        istringstream in(line);
+        Frame frame;
+        int marker;
+        size_t count;
+        in >> frame.name >> marker >> count;
+        frame.detections.marker = (Marker)marker;
+        for (size_t i = 0; i < count; i++){
+            Blob blob;
+            in >> blob.centre.x >> blob.centre.y >> blob.area;
+            frame.detections.blobs.push_back(blob);
+        }
+        in >> count;
+        for (size_t i = 0; i < count; i++){
+            Ball ball;
+            in >> ball.centre.x >> ball.centre.y >> ball.radius;
+            frame.detections.balls.push_back(ball);
+        }
+        in >> frame.detections.ms;
+        if (!in){
+            cerr << "Corrupt line in " << fileName << ": " << line << endl;
+            return false;
+        }
+        results.push_back(frame);
+    }
+    return true;
+}
+
+/** Process all the pictures, store results and compare them with golden ones. If there is no golden file yet, current results become golden.
+A corrupt golden file fails the test and is kept.
+@param goldenFile - stored results, file name in the directory.
+@param resultsFile - current results, file name in the directory.
+@return - detections are the same as golden ones.
+*/
+bool Regression::run(string goldenFile, string resultsFile){
+    if (!list())
+        return false;
+
+    process();
+
+    write(directory + resultsFile, frames);
+    compareBallEngines();
+
+    vector<Frame> golden;
+    if (!ifstream((directory + goldenFile).c_str())){ /// Only a missing file is replaced, never an unreadable one.
+        write(directory + goldenFile, frames);
+        cout << "No golden results, " << goldenFile << " created." << endl;
+        return true;
+    }
+    if (!read(directory + goldenFile, golden)){
+        cerr << "Golden results " << goldenFile << " are corrupt, fix or delete them. Regression test FAILED." << endl;
+        return false;
+    }
+
+    bool ok = compare(golden);
+    cout << (ok ? "Regression test passed." : "Regression test FAILED.") << endl;
+    return ok;
+}
+
+/** Accuracy and speed on synthetic pictures with exact ground truth, no camera or stored pictures needed.
+@param params - imaging conditions, including the picture's size.
+@param count - number of pictures
+@return - accuracy
+*/
+SceneScore Regression::synthetic(SceneParams params, int count){
+    /// Render first, so rendering does not count in speed.
+    SceneGenerator generator(params);
+    frames.assign(count, Frame());
+    for (int i = 0; i < count; i++)
+        generator.next(frames[i].image, frames[i].truth);
+
+    cout << "Synthetic " << params.size.width << "x" << params.size.height << ", brightness " << params.brightness << ", gradient " <<
+        params.gradient << ", noise " << params.noise << ", blur " << params.blur << ", perspective " << params.perspective << ":" << endl;
+    process();
+    SceneScore score = accuracy();
+    frames.clear();
+    return score;
+}
+
+/** Worker thread. Takes pictures one by one until all are processed. Uses its own Detector, with the robot's profile.
+*/
+void Regression::work(){
+    Detector detector(thresh);
+    detector.profileLoad(); /// The same parameters as on the robot
+    const Scalar low = detector.paramsGet().ballLow, high = detector.paramsGet().ballHigh;
+    Mat image, yuv;
+    size_t i;
+    while ((i = nextFrame++) < frames.size()){
+        /// YUV pictures, recorded by Camera in CAPTURE_YUV420 format, go through the YUV path. Balls still need BGR.
+        const string &name = frames[i].name;
+        bool isYuv = name.size() > 8 && name.compare(name.size() - 8, 8, ".yuv.png") == 0;
+        if (!frames[i].image.empty())
+            image = frames[i].image;
+        else if (isYuv){
+            yuv = imread(directory + name, IMREAD_GRAYSCALE);
+            if (!yuv.empty())
+                cvtColor(yuv, image, COLOR_YUV2BGR_I420);
+        }
+        else
+            image = imread(directory + name, IMREAD_COLOR);
+        if ((isYuv && yuv.empty()) || image.empty()){
+            cerr << "Could not open or find the image " << name << endl;
+            continue;
+        }
+
+        Detections &detections = frames[i].detections;
+        if (isYuv)
+            detector.crossingYuv(yuv, detections);
+        else
+            detector.crossing(image, detections);
+        double ms = detections.ms;
+        detector.ballEngineSet(BALLS_HOUGH); /// Whatever the profile chose, the golden balls are Hough's.
+        detector.circles(image, low[0], high[0], low[1], high[1], low[2], high[2], detections);
+        frames[i].houghMs = detections.ms;
+        detections.ms += ms;
+
+        detector.ballEngineSet(BALLS_CONTOUR);
+        detector.circles(image, low[0], high[0], low[1], high[1], low[2], high[2], frames[i].contourBalls);
+    }
+}
+
+/** Write results.
+@param fileName - file
+@param results - results to be written
+@return - success
+*/
+bool Regression::write(string fileName, const vector<Frame> &results){
+    ofstream file(fileName.c_str());
+    if (!file){
+        cerr << "Could not write " << fileName << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < results.size(); i++){
+        const Detections &detections = results[i].detections;
+        file << results[i].name << " " << detections.marker << " " << detections.blobs.size();
+        for (size_t j = 0; j < detections.blobs.size(); j++)
+            file << " " << detections.blobs[j].centre.x << " " << detections.blobs[j].centre.y << " " << detections.blobs[j].area;
+        file << " " << detections.balls.size();
+        for (size_t j = 0; j < detections.balls.size(); j++)
+            file << " " << detections.balls[j].centre.x << " " << detections.balls[j].centre.y << " " << detections.balls[j].radius;
+        file << " " << detections.ms << endl;
+    }
+    return true;
+}
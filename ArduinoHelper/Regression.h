@@ -0,0 +1,96 @@
+#ifndef REGRESSION_H_INCLUDED
+#define REGRESSION_H_INCLUDED
+#include "Detector.h"
+#include "SceneGenerator.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+/** Regression test: process a recorded corpus of pictures on all the cores and compare detections and speed with stored (golden) results.
+Runs uncalibrated, without FLOOR_CALIBRATION: line and marker logic use fixed fractions of the picture, so golden results do not depend on a
+robot's calibration file.
+*/
+class Regression{
+    public:
+        /** Constructor
+        @param directory - directory with recorded pictures.
+        @param thresh - Canny threshold.
+        */
+        Regression(std::string directory, int thresh = 100);
+
+        /** Process all the pictures, store results and compare them with golden ones. If there is no golden file yet, current results become golden.
+        A corrupt golden file fails the test and is kept.
+        @param goldenFile - stored results, file name in the directory.
+        @param resultsFile - current results, file name in the directory.
+        @return - detections are the same as golden ones.
+        */
+        bool run(std::string goldenFile = "golden.txt", std::string resultsFile = "results.txt");
+
+        /** Accuracy and speed on synthetic pictures with exact ground truth, no camera or stored pictures needed.
+        @param params - imaging conditions, including the picture's size.
+        @param count - number of pictures
+        @return - accuracy
+        */
+        SceneScore synthetic(SceneParams params, int count = 500);
+
+    private:
+        /** Detections for one picture.
+        */
+        struct Frame{
+            std::string name; /// Picture's file name
+            Detections detections; /// Found objects
+            Detections contourBalls; /// Balls found by the contour algorithm, to be compared with Hough
+            double houghMs = 0; /// Hough ball detection's time
+            Mat image; /// Synthetic picture, empty for recorded ones.
+            SceneTruth truth; /// Synthetic picture's content
+        };
+
+        std::string directory; /// Recorded pictures
+        std::vector<Frame> frames; /// Current results, sorted by name
+        std::atomic<size_t> nextFrame; /// Next picture to be processed by any worker
+        int thresh; /// Threshold for Canny algorithm.
+
+        /** Compare current results with ground truth of synthetic pictures and print accuracy.
+        @return - accuracy
+        */
+        SceneScore accuracy();
+
+        /** Compare current results with golden ones and print differences.
+        @param golden - golden results
+        @return - detections are the same.
+        */
+        bool compare(const std::vector<Frame> &golden);
+
+        /** Compare ball detection algorithms: speed and agreement with Hough.
+        */
+        void compareBallEngines();
+
+        /** Find all the pictures in the directory.
+        @return - success
+        */
+        bool list();
+
+        /** Process all the frames on all the cores and print speed.
+        */
+        void process();
+
+        /** Read results.
+        @param fileName - file
+        @param results - results read
+        @return - success
+        */
+        static bool read(std::string fileName, std::vector<Frame> &results);
+
+        /** Worker thread. Takes pictures one by one until all are processed. Uses its own Detector, with the robot's profile.
+        */
+        void work();
+
+        /** Write results.
+        @param fileName - file
+        @param results - results to be written
+        @return - success
+        */
+        static bool write(std::string fileName, const std::vector<Frame> &results);
+};
+
+#endif // REGRESSION_H_INCLUDED
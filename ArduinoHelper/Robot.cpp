@@ -1,5 +1,10 @@
 #include <iostream>
+#include "Regression.h"
 #include "Robot.h"
+#include "SharedBus.h"
+#include "Tuner.h"
+#include "UartReplay.h"
+#include <string.h>
 #include <wiringPi.h>
 
 using namespace std;
@@ -8,107 +13,463 @@ using namespace std;
 @param state - initial state
 @param thresh - OpenCV Canny's threshold
 @param saveImages - save to disk
+@param captureFormat - camera's picture format
 */
-Robot::Robot(State stateNow, int thresh, bool saveImages){
+Robot::Robot(State stateNow, int threshold, bool saveImagesNow, CaptureFormat captureFormatNow){
+    startupMs = millis();
     state = stateNow;
-    camera = new Camera(thresh, saveImages);
-    uart = new UART();
+    thresh = threshold;
+    saveImages = saveImagesNow;
+    captureFormat = captureFormatNow;
+    /// Subsystems are created on first use, so each state opens only what it needs. Bus consumers never open the camera, for example.
     message = new Message();
+
+    /// Inbound commands: Arduino changes the state. 'l' and 'r' go only from RPI to Arduino, so they are unknown here.
+    dispatcher.add('I', 0, [this](const uint8_t *){ command(IDLE);});
+    dispatcher.add('L', 0, [this](const uint8_t *){ command(LINE);});
+    dispatcher.add('R', 0, [this](const uint8_t *){ command(RED_ROOM);});
 }
 
+/** States' handlers, in State's order. Programs (tests, bus processes) run in a single tick; run states tick while Arduino's commands switch
+between them. Bus processes only record the commands; the UART bridge ticks and accepts them.
+*/
+const Robot::StateHandlers Robot::stateHandlers[STATE_COUNT] = {
+    {"FIND_CIRCLES", 0, [](Robot &robot){ robot.cameraGet()->findCirclesUsingTrackbars(); robot.running = false;}, 0, false, false},
+    {"CALIBRATE_BALL", 0, [](Robot &robot){ robot.cameraGet()->calibrateBall(); robot.running = false;}, 0, false, false},
+    {"CROSSING_SINGLE", 0, [](Robot &robot){ robot.cameraGet()->crossing(true); robot.running = false;}, 0, false, false},
+    {"CROSSING_CONTINUOUS", 0, [](Robot &robot){ robot.cameraGet()->crossing(false); robot.running = false;}, 0, false, false},
+    {"TEST_STORED_IMAGES", 0, [](Robot &robot){ robot.cameraGet()->unitTest(); robot.running = false;}, 0, false, false},
+    {"TEST_CAMERA_IMAGES", 0, [](Robot &robot){ cerr << "TEST_CAMERA_IMAGES is not implemented." << endl; robot.running = false;}, 0, false, false},
+    {"TEST_UART", 0, [](Robot &robot){ robot.uartTestTick();}, 0, false, false},
+    {"TEST_UART_MESSAGES", 0, 0, 0, true, false},
+    {"DETECT_ALL", 0, [](Robot &robot){ robot.cameraGet()->detectAll(true); robot.running = false;}, 0, false, false},
+    {"TEST_SYNTHETIC_IMAGES", 0, [](Robot &robot){ robot.syntheticTest(); robot.running = false;}, 0, false, false},
+    {"TUNE_DETECTOR", 0, [](Robot &robot){ robot.tuneDetector(); robot.running = false;}, 0, false, false},
+    {"UART_REPLAY", 0, [](Robot &robot){ robot.uartReplay(true); robot.running = false;}, 0, false, false},
+    {"UART_REPLAY_FAST", 0, [](Robot &robot){ robot.uartReplay(false); robot.running = false;}, 0, false, false},
+    {"TEST_UART_BRIDGE", 0, [](Robot &robot){ robot.bridgeTest(); robot.running = false;}, 0, false, false},
+    {"CAMERA_SERVER", 0, [](Robot &robot){ robot.cameraGet()->serve(); robot.running = false;}, 0, false, true},
+    {"VISION_WORKER", 0, [](Robot &robot){ robot.visionWorker(); robot.running = false;}, 0, false, true},
+    {"UART_BRIDGE", [](Robot &robot){ robot.bridgeEnter();}, [](Robot &robot){ robot.bridgeTick();}, 0, true, true},
+    {"DETECTION_LOGGER", 0, [](Robot &robot){ robot.detectionLogger(); robot.running = false;}, 0, false, true},
+    {"IDLE", 0, 0, 0, true, false},
+    {"LINE", 0, [](Robot &robot){ robot.lineTick();}, 0, true, false},
+    {"RED_ROOM", 0, 0, 0, true, false}};
+
 Robot::~Robot(){
+    if (cameraWarmer.joinable())
+        cameraWarmer.join();
+    delete camera;
+    delete uart; /// Before the recorder stops, so the last bytes are recorded.
+    uartRecorder.stop();
+    delete message;
 }
 
-/** Start and choose action
+/** Camera, created on first use. If a warm-up is running, waits for it.
+@return - camera
+*/
+Camera *Robot::cameraGet(){
+    if (cameraWarmer.joinable())
+        cameraWarmer.join();
+    if (camera == 0){
+        uint32_t phaseStartMs = millis();
+        camera = new Camera(thresh, saveImages, captureFormat);
+        camera->warmUp();
+        startupReport("camera", phaseStartMs);
+    }
+    return camera;
+}
+
+/** Create the camera and wait for its first picture in the background, while the main thread already serves UART.
+*/
+void Robot::cameraWarmUp(){
+    if (camera != 0 || cameraWarmer.joinable())
+        return;
+    cameraWarmer = thread([this]{
+        uint32_t phaseStartMs = millis();
+        camera = new Camera(thresh, saveImages, captureFormat);
+        camera->warmUp();
+        startupReport("camera (background)", phaseStartMs);
+    });
+}
+
+/** State-machine runtime: runs the current state's handlers until a program ends. Each tick, all the queued inbound commands are
+dispatched first, in states accepting them. A changed state's exit handler is called, then the new one's enter handler.
 */
 void Robot::run(){
-    if (state == TEST_UART)
-        uartTest();
-    else if (state == TEST_UART_MESSAGES)
-        uartMessagesTest();
-    else if (state == FIND_CIRCLES)
-        camera->findCirclesUsingTrackbars();
-    else if (state == CALIBRATE_BALL)
-        camera->calibrateBall();
-    else if (state == CROSSING_SINGLE)
-        camera->crossing(true);
-    else if (state == CROSSING_CONTINUOUS)
-        camera->crossing(false);
+    startupReport("robot", startupMs);
+
+    /// States driven by Arduino will need vision soon, but must answer commands at once.
+    if (state == TEST_UART_MESSAGES || state == LINE || state == RED_ROOM)
+        cameraWarmUp();
+    verbose = state == TEST_UART_MESSAGES;
+
+    /// Each process serves its metrics on a socket named by its initial state, for example /tmp/mrms-metrics-VISION_WORKER.sock.
+    metricsServer.start(string(METRICS_SOCKET) + stateHandlers[state].name + ".sock");
+    Metrics::stateSet(state, stateHandlers[state].name);
+
+    State initial = state;
+    State current = state;
+    running = true;
+    if (stateHandlers[current].enter != 0)
+        stateHandlers[current].enter(*this);
+    while (running){
+        const StateHandlers &handlers = stateHandlers[current];
+        if (handlers.commands)
+            dispatcher.dispatch(*uartGet(), verbose);
+        if (handlers.tick != 0)
+            handlers.tick(*this);
+        else
+            delay(1); /// Nothing to do but wait for commands.
+
+        /// A command or a handler changed the state.
+        if (state != current){
+            if (handlers.exit != 0)
+                handlers.exit(*this);
+            cout << "State " << handlers.name << " -> " << stateHandlers[state].name << endl;
+            Metrics::stateSet(state, stateHandlers[state].name);
+            dispatcher.report();
+            current = state;
+
+            /// The UART messages test runs until Arduino commands IDLE, as in Arduino's MRMS_Line_RPI test.
+            if (initial == TEST_UART_MESSAGES && state == IDLE)
+                running = false;
+            if (stateHandlers[current].enter != 0)
+                stateHandlers[current].enter(*this);
+        }
+    }
+    if (stateHandlers[current].exit != 0)
+        stateHandlers[current].exit(*this);
+}
+
+/** UART bridge test: Arduino's 'L' reaching the bridge must not stop it forwarding markers. No Arduino or vision worker needed.
+@return - passed
+*/
+bool Robot::bridgeTest(){
+    State saved = state;
+    state = UART_BRIDGE; /// Posing as the bridge, so the commands are handled as there.
+    bridgePosition = -1;
+    const uint8_t line = 'L';
+    dispatcher.dispatch(&line, 1, verbose);
+
+    DetectionRecord record;
+    memset(&record, 0, sizeof(record));
+    record.lineX = -1;
+    record.marker = MARKER_LEFT;
+    bool passed = state == UART_BRIDGE && commanded == LINE && bridgeForward(record) && bridgePosition == 0;
+    record.marker = MARKER_RIGHT;
+    passed = passed && bridgeForward(record) && bridgePosition == LINE_POSITION_MAXIMUM && (*message)[0] == 'l';
+    if (passed)
+        cout << "Bridge test passed: 'L' recorded, markers still forwarded." << endl;
     else
-        exit(9);
-}
-
-/** Reads messages and triggers appropriate actions
-@param verbose - detailed output
- */
-void Robot::uartMessagesInboundHandle(bool verbose){
-    if (uart->available()){
-        Message message = uart->readMessage(verbose);
-        uint8_t messageId = message.readUInt8();
-        switch (messageId) {
-            case 'I': /// New state: IDLE
-                stateSet(IDLE);
-                break;
-            case 'l': /// Impossible for RPI
-                exit(11);
-            case 'L': /// New state: LINE
-                stateSet(LINE);
-                break;
-            case 'r': /// Impossible for RPI
-                exit(12);
-            case 'R': /// New state: RED_ROOM
-                stateSet(RED_ROOM);
-                break;
-            default: // RPI cannot command Arduino to change state
-                cerr << "Impossible message id: " << messageId << endl;
-                exit(11);
+        cerr << "Bridge test FAILED: 'L' must not stop the UART bridge forwarding markers." << endl;
+    state = saved;
+    return passed;
+}
+
+/** UART bridge state's enter: waits for the vision worker's detections.
+*/
+void Robot::bridgeEnter(){
+    while (!bridgeDetections.open())
+        delay(100);
+    bridgeLast = bridgeDetections.published();
+    bridgePosition = -1;
+}
+
+/** UART bridge: builds the 'l' message for Arduino from detections, if the line position changed. A marker steers to its side: left
+sends 0, right LINE_POSITION_MAXIMUM. The protocol has no message of its own for markers.
+@param record - detections
+@return - message is to be sent.
+*/
+bool Robot::bridgeForward(const DetectionRecord &record){
+    int16_t position = -1;
+    if (record.marker == MARKER_LEFT)
+        position = 0;
+    else if (record.marker == MARKER_RIGHT)
+        position = LINE_POSITION_MAXIMUM;
+    else if (record.lineX >= 0 && record.cols > 1)
+        position = record.lineX * LINE_POSITION_MAXIMUM / (record.cols - 1);
+    if (position == -1 || position == bridgePosition)
+        return false;
+
+    /// Construct a message: new x position, as in the LINE test.
+    bridgePosition = position;
+    message->reset();
+    message->append((uint8_t)'l');
+    message->append((uint16_t)position);
+    return true;
+}
+
+/** UART bridge state's tick: sends the line position to Arduino, when it changes. Arduino's commands are only recorded, the bridge keeps
+forwarding.
+*/
+void Robot::bridgeTick(){
+    DetectionRecord record;
+    if (bridgeDetections.wait(bridgeLast, 10)){
+        bridgeLast = bridgeDetections.published(); /// Only the newest detections matter.
+        if (bridgeDetections.read(bridgeLast, record) && bridgeForward(record))
+            uartGet()->write(*message);
+    }
+}
+
+/** Inbound command: Arduino switches the run state. Bus processes only record it and keep doing their own job.
+@param newState - commanded run state
+*/
+void Robot::command(State newState){
+    if (newState != commanded && verbose)
+        cout << "Commanded " << stateHandlers[newState].name << "." << endl;
+    commanded = newState;
+    if (!stateHandlers[state].busProcess)
+        stateSet(newState);
+}
+
+/** Detection logger: prints detections published by the vision worker.
+*/
+void Robot::detectionLogger(){
+    DetectionBus detections;
+    while (!detections.open())
+        delay(100);
+
+    uint32_t last = detections.published();
+    DetectionRecord record;
+    while (true){
+        if (!detections.wait(last))
+            continue;
+        uint32_t newest = detections.published();
+        if (newest < last)
+            last = 0; /// Vision worker restarted, numbers start again.
+        if (newest - last > BUS_DETECTION_SLOTS)
+            last = newest - BUS_DETECTION_SLOTS; /// Too slow, the oldest are overwritten.
+        while (last != newest){
+            last++;
+            if (detections.read(last, record))
+                cout << record.frameNumber << " " << record.captureMs << " marker " << record.marker << " blobs " << (int)record.blobCount <<
+                    " balls " << (int)record.ballCount << " " << record.ms << " ms" << endl;
+        }
+    }
+}
+
+/** Metrics CLI: prints the metrics of running instances.
+@param stateName - only the instance started in this state, all if 0.
+@param periodMs - repeat with this period, once if 0.
+@return - an instance answered.
+*/
+bool Robot::metricsShow(const char *stateName, uint32_t periodMs){
+    bool answered;
+    do{
+        answered = false;
+        for (int i = 0; i < STATE_COUNT; i++){
+            string text;
+            if ((stateName == 0 || strcmp(stateName, stateHandlers[i].name) == 0) &&
+                Metrics::query(string(METRICS_SOCKET) + stateHandlers[i].name + ".sock", text)){
+                cout << "== " << stateHandlers[i].name << " ==" << endl << text;
+                answered = true;
+            }
         }
+        if (!answered)
+            cerr << "No running instance answered." << endl;
+        delay(periodMs);
+    } while (periodMs != 0);
+    return answered;
+}
+
+/** State from its name, for example "VISION_WORKER".
+@param name - state's name
+@param state - found state
+@return - name is valid
+*/
+bool Robot::stateFromName(const char *name, State &state){
+    for (int i = 0; i < STATE_COUNT; i++)
+        if (strcmp(name, stateHandlers[i].name) == 0){
+            state = (State)i;
+            return true;
+        }
+    return false;
+}
+
+/** Accuracy and speed of the detectors on synthetic pictures, under various imaging conditions and resolutions. No camera needed.
+*/
+void Robot::syntheticTest(){
+    Regression regression("", thresh);
+    SceneParams params;
+    SceneScore ideal = regression.synthetic(params); /// Ideal pictures
+    if (ideal.linesFound != ideal.pictures || ideal.linesWrong != 0)
+        cerr << "Line check FAILED: ideal pictures must all have the line found within tolerance." << endl;
+
+    params.noise = 8;
+    params.blur = 3;
+    regression.synthetic(params); /// Sensor noise and focus
+
+    params.brightness = 0.7;
+    params.gradient = 0.4;
+    regression.synthetic(params); /// Dim, uneven light
+
+    params.perspective = 0.5;
+    regression.synthetic(params); /// Tilted camera
+
+    params = SceneParams();
+    params.size = Size(640, 480);
+    regression.synthetic(params, 100); /// Throughput at a higher resolution
+}
+
+/** LINE state's tick, a test initiated from Arduino UART.ino in UART library: sends a random line position every 100 ms.
+*/
+void Robot::lineTick(){
+    if (millis() - lineSentMs > 100){ /// Every 100 ms
+        lineSentMs = millis();
+
+        lineX += rand() % 11 - 5; /// Add between -5 and 5
+        if (lineX < 0)
+            lineX = 0;
+        if (lineX > LINE_POSITION_MAXIMUM)
+            lineX = LINE_POSITION_MAXIMUM;
+
+        /// Construct and send a message: new x position
+        message->reset();
+        message->append((uint8_t)'l');
+        message->append((uint16_t)lineX);
+        uartGet()->write(*message, verbose);
+    }
+    delay(1);
+}
+
+/** Print a startup phase's duration.
+@param phase - phase's name
+@param phaseStartMs - phase's start, millis()
+*/
+void Robot::startupReport(const char *phase, uint32_t phaseStartMs){
+    uint32_t nowMs = millis();
+    cout << "Startup: " << phase << " " << (nowMs - phaseStartMs) << " ms, ready " << (nowMs - startupMs) << " ms after start." << endl;
+}
+
+/** Search detector parameters over a labelled corpus and store the chosen profile, which Camera loads at startup.
+*/
+void Robot::tuneDetector(){
+    DetectorParams base;
+    base.cannyThreshold = thresh;
+    base.load(DETECTOR_PROFILE); /// Continue from the last profile, if any.
+    Tuner tuner(base, captureFormat == CAPTURE_YUV420);
+
+    /// A recorded, labelled corpus is best. Without it, synthetic pictures with some noise.
+    if (!tuner.corpusLoad("/home/pi/corpus/")){
+        SceneParams params;
+        params.noise = 6;
+        params.blur = 3;
+        params.gradient = 0.2;
+        tuner.corpusSynthetic(params, 300);
+    }
+
+    DetectorParams best = tuner.run(200, 10);
+    if (best.save(DETECTOR_PROFILE))
+        cout << "Profile written to " << DETECTOR_PROFILE << "." << endl;
+}
+
+/** Serial port, opened on first use.
+@return - serial port
+*/
+UART *Robot::uartGet(){
+    if (uart == 0){
+        uint32_t phaseStartMs = millis();
+        uart = new UART();
+        if (!uartRecordFile.empty() && uartRecorder.start(uartRecordFile))
+            uart->recorderSet(&uartRecorder);
+        startupReport("UART", phaseStartMs);
     }
+    return uart;
 }
 
-/** Part of the test initiated from Arduino UART.ino in UART library.
-*/
-void Robot::uartMessagesTest(){
-    uint32_t lastSentMs = 0;
-    int16_t x = 40;
-    while (state != IDLE){
-        switch(state){
-            case LINE:
-                if (millis() - lastSentMs > 100){ /// Every 100 ms
-                    lastSentMs = millis();
-
-                    x += rand() % 11 - 5; /// Add between -5 and 5
-                    if (x < 0)
-                        x = 0;
-                    if (x > 80)
-                        x = 80;
-
-                    /// Construct and send a message: new x position
-                    message->reset();
-                    message->append((uint8_t)'l');
-                    message->append((uint16_t)x);
-                    uart->write(*message, true);
-                }
-                break;
-            case RED_ROOM:
-                break;
-            case TEST_UART_MESSAGES:
-                break;
-            default:
-                exit(8);
+/** Feed a recorded session into the inbound commands' handlers over a pseudo-terminal and measure the throughput. No Arduino needed.
+@param realTime - recorded timing, otherwise as fast as possible.
+*/
+void Robot::uartReplay(bool realTime){
+    UartReplay replay;
+    if (!replay.open(UART_SESSION))
+        exit(15);
+    UART replayUart(replay.device()); /// Not uartGet(): the replay must not be recorded over the session.
+
+    State replayState = state;
+    uint32_t messages = 0;
+    uint32_t transitions = 0;
+    uint32_t startUs = micros();
+    uint32_t lastUs = startUs;
+    replay.start(realTime);
+    for (uint32_t idleMs = millis(); !replay.finished() || millis() - idleMs < 100;){
+        int count = dispatcher.dispatch(replayUart, verbose);
+        if (count > 0){
+            messages += count;
+            lastUs = micros();
+            idleMs = millis();
+        }
+        if (state != replayState){ /// Commands switch the state, as in a run. Counted, but the states are not entered.
+            transitions++;
+            replayState = state;
         }
-        uartMessagesInboundHandle(true);
     }
+
+    uint32_t elapsedUs = max(lastUs - startUs, 1u);
+    cout << "Replayed " << messages << " messages, " << replay.bytes() << " bytes in " << elapsedUs / 1000.0 << " ms: " <<
+        messages * 1000000.0 / elapsedUs << " messages/s, " << replay.bytes() * 1000000.0 / elapsedUs << " bytes/s." << endl;
+    cout << transitions << " state changes, final state " << stateHandlers[state].name << "." << endl;
+    dispatcher.report();
+    state = realTime ? UART_REPLAY : UART_REPLAY_FAST;
 }
 
+/** TEST_UART state's tick, part of the test initiated from Arduino MRMS_Line_RPI in MRMS_Line_RPI library: prints received bytes.
+*/
+void Robot::uartTestTick(){
+    if (uartGet()->available()){
+        cout << uartGet()->read();
+        cout.flush();
+    }
+}
 
-/** Part of the test initiated from Arduino MRMS_Line_RPI in MRMS_Line_RPI library.
+/** Vision worker: processes frames published by the camera server and publishes detections.
 */
-void Robot::uartTest(){
+void Robot::visionWorker(){
+    FrameBus frames;
+    while (!frames.open())
+        delay(100);
+    DetectionBus detectionBus;
+    if (!detectionBus.create())
+        exit(14);
+
+    Detector detector(thresh);
+    if (detector.profileLoad())
+        cout << "Profile " << DETECTOR_PROFILE << " loaded." << endl;
+    detector.changeDetectionEnable(true); /// Static scenes: reuse the previous detections while nothing changes.
+    FloorMap floorMap;
+    Size floorFrame; /// Frame's size the floor tables were built for
+    Detections detections;
+    DetectionRecord record;
+    Mat image;
+    uint32_t last = 0;
     while (true){
-        if (uart->available()){
-            cout << uart->read();
-            cout.flush();
+        if (!frames.wait(last))
+            continue;
+        uint32_t number, captureMs;
+        if (!frames.latest(image, number, captureMs))
+            continue;
+
+        /// Floor-plane calibration, as in Camera, so both paths decide the same on the same frame. Tables cover the cropped part.
+        if (image.size() != floorFrame){
+            floorFrame = image.size();
+            bool calibrated = floorMap.load(FLOOR_CALIBRATION, Detector::crop(floorFrame));
+            detector.floorMapSet(calibrated ? &floorMap : 0);
+            if (calibrated)
+                cout << "Floor " << FLOOR_CALIBRATION << " calibrated." << endl;
+        }
+        if (number < last)
+            last = 0; /// Camera server restarted, numbers start again.
+        if (last != 0 && number - last > 1)
+            Metrics::add(METRIC_FRAMES_DROPPED, number - last - 1); /// Published while the previous one was processed
+        last = number;
+        detector.crossing(image, detections);
+        if (!frames.valid(number)){
+            Metrics::add(METRIC_FRAMES_DROPPED);
+            continue; /// Overwritten while processing, results are not reliable.
         }
+        Metrics::add(METRIC_FRAMES_PROCESSED);
+        record.set(detections, number, captureMs, detector.roi().cols);
+        detectionBus.publish(record);
     }
 }
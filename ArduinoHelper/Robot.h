@@ -2,7 +2,16 @@
 #define ROBOT_H
 
 #include "Camera.h"
+#include "MessageDispatcher.h"
+#include "Metrics.h"
+#include "SharedBus.h"
 #include "UART.h"
+#include "UartRecorder.h"
+#include <string>
+#include <thread>
+
+#define LINE_POSITION_MAXIMUM 80 /// 'l' message's range: 0 is the picture's left edge, 40 its centre, 80 its right edge.
+#define UART_SESSION "/home/pi/uart.rec" /// Recorded UART session, for UART_REPLAY and UART_REPLAY_FAST
 
 class Robot
 {
@@ -11,25 +20,43 @@ class Robot
         enum State {
             /// Tests
             FIND_CIRCLES, CALIBRATE_BALL, CROSSING_SINGLE, CROSSING_CONTINUOUS, TEST_STORED_IMAGES,
-            TEST_CAMERA_IMAGES, TEST_UART, TEST_UART_MESSAGES,
+            TEST_CAMERA_IMAGES, TEST_UART, TEST_UART_MESSAGES, DETECT_ALL, TEST_SYNTHETIC_IMAGES, TUNE_DETECTOR,
+            UART_REPLAY, UART_REPLAY_FAST, TEST_UART_BRIDGE,
+            /// Processes sharing frames and detections through shared memory
+            CAMERA_SERVER, VISION_WORKER, UART_BRIDGE, DETECTION_LOGGER,
             /// Run states
-            IDLE, LINE, RED_ROOM};
+            IDLE, LINE, RED_ROOM,
+            STATE_COUNT /// Number of states, not a state
+        };
 
         /** Constructor
         @param state - initial state
         @param thresh - OpenCV Canny's threshold
         @param saveImages - save to disk
+        @param captureFormat - camera's picture format
         */
-        Robot(State state = IDLE, int thresh = 100, bool saveImages = false);
+        Robot(State state = IDLE, int thresh = 100, bool saveImages = false, CaptureFormat captureFormat = CAPTURE_BGR);
 
         /** Destructor
         */
         virtual ~Robot();
 
-        /** Start
+        /** State-machine runtime: runs the current state's handlers until a program ends. Each tick, all the queued inbound commands are
+        dispatched first, in states accepting them. A changed state's exit handler is called, then the new one's enter handler.
         */
         void run();
 
+        /** Detection logger: prints detections published by the vision worker.
+        */
+        void detectionLogger();
+
+        /** Metrics CLI: prints the metrics of running instances.
+        @param stateName - only the instance started in this state, all if 0.
+        @param periodMs - repeat with this period, once if 0.
+        @return - an instance answered.
+        */
+        static bool metricsShow(const char *stateName, uint32_t periodMs);
+
         /** Get state
         @return - current state
         */
@@ -40,24 +67,124 @@ class Robot
         */
         void stateSet(State newState){ state = newState;}
 
-        /** Reads messages and triggers appropriate actions
-        @param verbose - detailed output
+        /** State from its name, for example "VISION_WORKER".
+        @param name - state's name
+        @param state - found state
+        @return - name is valid
+        */
+        static bool stateFromName(const char *name, State &state);
+
+        /** Accuracy and speed of the detectors on synthetic pictures, under various imaging conditions and resolutions. No camera needed.
+        */
+        void syntheticTest();
+
+        /** Search detector parameters over a labelled corpus and store the chosen profile, which Camera loads at startup.
         */
-        void uartMessagesInboundHandle(bool verbose = false);
+        void tuneDetector();
 
-        /** Part of the test initiated from Arduino UART.ino in UART library.
+        /** Record all the UART traffic, once the serial port is opened.
+        @param fileName - session file
         */
-        void uartMessagesTest();
+        void uartRecordSet(const std::string &fileName){ uartRecordFile = fileName;}
 
-        /** Part of the test initiated from Arduino MRMS_Line_RPI in MRMS_Line_RPI library.
+        /** Feed a recorded session into the inbound commands' handlers over a pseudo-terminal and measure the throughput. No Arduino needed.
+        @param realTime - recorded timing, otherwise as fast as possible.
         */
-        void uartTest();
+        void uartReplay(bool realTime);
+
+        /** Vision worker: processes frames published by the camera server and publishes detections.
+        */
+        void visionWorker();
 
     private:
-        Camera *camera; /// RPI camera
+        /** A state's behaviour, for the state-machine runtime. Any handler may be 0.
+        */
+        struct StateHandlers{
+            const char *name; /// State's name, for example in the command line.
+            void (*enter)(Robot &robot); /// On entering the state
+            void (*tick)(Robot &robot); /// Repeatedly, while in the state. A program runs to its end in one tick and stops the runtime.
+            void (*exit)(Robot &robot); /// On leaving the state
+            bool commands; /// Dispatch inbound UART commands before each tick.
+            bool busProcess; /// Bus process: inbound commands are only recorded, they do not switch the state.
+        };
+
+        static const StateHandlers stateHandlers[STATE_COUNT]; /// In State's order
+
+        DetectionBus bridgeDetections; /// UART bridge: detections from the vision worker
+        uint32_t bridgeLast = 0; /// UART bridge: last detections' number
+        int16_t bridgePosition = -1; /// UART bridge: last line position sent, -1 if none
+        State commanded = IDLE; /// Run state last commanded by Arduino. Bus processes record it without switching.
+        Camera *camera = 0; /// RPI camera, created on first use.
+        std::thread cameraWarmer; /// Creates the camera in the background
+        CaptureFormat captureFormat; /// Camera's picture format
+        MessageDispatcher dispatcher; /// Inbound commands' handlers
+        uint32_t lineSentMs = 0; /// LINE test: last position's time
+        MetricsServer metricsServer; /// Serves the metrics to "ArduinoHelper METRICS"
+        int16_t lineX = 40; /// LINE test: position sent
+        bool running = false; /// Runtime continues
         State state; /// Robot's state - according to State Machine pattern
-        UART *uart; /// Serial port
+        UART *uart = 0; /// Serial port, opened on first use.
+        std::string uartRecordFile; /// Record the traffic here, if not empty.
+        UartRecorder uartRecorder; /// Records the traffic
         Message *message; /// Current (or last) message
+        bool saveImages; /// Camera saves pictures to disk
+        uint32_t startupMs; /// Robot's creation time, millis()
+        int thresh; /// OpenCV Canny's threshold
+        bool verbose = false; /// Print inbound and outbound messages
+
+        /** UART bridge test: Arduino's 'L' reaching the bridge must not stop it forwarding markers. No Arduino or vision worker needed.
+        @return - passed
+        */
+        bool bridgeTest();
+
+        /** UART bridge state's enter: waits for the vision worker's detections.
+        */
+        void bridgeEnter();
+
+        /** UART bridge: builds the 'l' message for Arduino from detections, if the line position changed. A marker steers to its side: left
+        sends 0, right LINE_POSITION_MAXIMUM. The protocol has no message of its own for markers.
+        @param record - detections
+        @return - message is to be sent.
+        */
+        bool bridgeForward(const DetectionRecord &record);
+
+        /** UART bridge state's tick: sends the line position to Arduino, when it changes. Arduino's commands are only recorded, the bridge keeps
+        forwarding.
+        */
+        void bridgeTick();
+
+        /** Inbound command: Arduino switches the run state. Bus processes only record it and keep doing their own job.
+        @param newState - commanded run state
+        */
+        void command(State newState);
+
+        /** Camera, created on first use. If a warm-up is running, waits for it.
+        @return - camera
+        */
+        Camera *cameraGet();
+
+        /** Create the camera and wait for its first picture in the background, while the main thread already serves UART.
+        */
+        void cameraWarmUp();
+
+        /** LINE state's tick, a test initiated from Arduino UART.ino in UART library: sends a random line position every 100 ms.
+        */
+        void lineTick();
+
+        /** Print a startup phase's duration.
+        @param phase - phase's name
+        @param phaseStartMs - phase's start, millis()
+        */
+        void startupReport(const char *phase, uint32_t phaseStartMs);
+
+        /** Serial port, opened on first use.
+        @return - serial port
+        */
+        UART *uartGet();
+
+        /** TEST_UART state's tick, part of the test initiated from Arduino MRMS_Line_RPI in MRMS_Line_RPI library: prints received bytes.
+        */
+        void uartTestTick();
 };
 
 #endif // ROBOT_H
@@ -0,0 +1,253 @@
+#include "SceneGenerator.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <opencv2/highgui/highgui.hpp>
+#include <sstream>
+#include <stdio.h>
+
+using namespace std;
+using namespace cv;
+
+/** Constructor
+@param params - imaging conditions
+*/
+SceneGenerator::SceneGenerator(SceneParams paramsNow) : rng(paramsNow.seed){
+    params = paramsNow;
+
+    /// The floor is wider than the picture, so the picture's upper row, farther away, sees more of it.
+    float width = params.size.width, height = params.size.height;
+    float floorWidth = width * (1 + params.perspective);
+    floor.create(Size(floorWidth, height), CV_8UC3);
+    vector<Point2f> floorCorners, pictureCorners;
+    floorCorners.push_back(Point2f(0, 0));
+    floorCorners.push_back(Point2f(floorWidth, 0));
+    floorCorners.push_back(Point2f(floorWidth - width * params.perspective / 2, height));
+    floorCorners.push_back(Point2f(width * params.perspective / 2, height));
+    pictureCorners.push_back(Point2f(0, 0));
+    pictureCorners.push_back(Point2f(width, 0));
+    pictureCorners.push_back(Point2f(width, height));
+    pictureCorners.push_back(Point2f(0, height));
+    homography = getPerspectiveTransform(floorCorners, pictureCorners);
+}
+
+/** Lighting and noise, in place.
+@param image - BGR picture
+*/
+void SceneGenerator::expose(Mat &image){
+    for (int y = 0; y < image.rows; y++){
+        uint8_t *pixel = image.ptr<uint8_t>(y);
+        for (int x = 0; x < image.cols; x++){
+            float factor = params.brightness * (1 + params.gradient * (0.5f - (float)x / max(1, image.cols - 1)));
+            for (int c = 0; c < 3; c++, pixel++){
+                float value = *pixel * factor;
+                if (params.noise > 0)
+                    value += rng.gaussian(params.noise);
+                *pixel = (uint8_t)max(0.0f, min(255.0f, value + 0.5f));
+            }
+        }
+    }
+}
+
+/** Render the next picture.
+@param image - BGR picture
+@param truth - its content
+*/
+void SceneGenerator::next(Mat &image, SceneTruth &truth){
+    const Scalar floorColor(235, 235, 235), lineColor(20, 20, 20), markerColor(30, 110, 30);
+    const Scalar ballColors[] = {Scalar(40, 40, 140), Scalar(140, 50, 40), Scalar(100, 100, 100)};
+    const float width = params.size.width, height = params.size.height;
+    const float lineWidth = width * 0.12; /// Proportions of a 160 x 120 picture of a RoboCup Line field
+    const float markerSide = width * 0.12;
+    const float markerGap = width * 0.01;
+
+    /// Floor: a crossing, the vertical line randomly shifted, the horizontal one at a random distance.
+    floor.setTo(floorColor);
+    float lineX = floor.cols / 2 + width * rng.uniform(-0.15f, 0.15f);
+    float crossingY = height * rng.uniform(0.45f, 0.6f);
+    rectangle(floor, Point(lineX - lineWidth / 2, 0), Point(lineX + lineWidth / 2, height), lineColor, FILLED);
+    rectangle(floor, Point(0, crossingY - lineWidth / 2), Point(floor.cols, crossingY + lineWidth / 2), lineColor, FILLED);
+
+    /// Markers below the horizontal line, next to the vertical one.
+    truth.markers = (SceneMarkers)rng.uniform(0, 4);
+    truth.marker = truth.markers == SCENE_LEFT ? MARKER_LEFT : truth.markers == SCENE_RIGHT ? MARKER_RIGHT : MARKER_NONE;
+    truth.markerCentres.clear();
+    float offset = lineWidth / 2 + markerGap + markerSide / 2;
+    for (int side = -1; side <= 1; side += 2){
+        if (!(truth.markers == SCENE_BOTH || (side < 0 && truth.markers == SCENE_LEFT) || (side > 0 && truth.markers == SCENE_RIGHT)))
+            continue;
+        Point2f centre(lineX + side * offset, crossingY + offset);
+        rectangle(floor, Point(centre.x - markerSide / 2, centre.y - markerSide / 2), Point(centre.x + markerSide / 2, centre.y + markerSide / 2),
+            markerColor, FILLED);
+        truth.markerCentres.push_back(project(centre));
+    }
+
+    /// Camera's view of the floor.
+    warpPerspective(floor, image, homography, params.size, INTER_LINEAR, BORDER_CONSTANT, floorColor);
+    /// Line's picture x in the middle row of the band stageLine() averages over: the cropped picture's bottom quarter.
+    Rect roi = Detector::crop(params.size);
+    float bandY = roi.y + (roi.height * 3 / 4 + roi.height) / 2.0f;
+    Point2f bottom = project(Point2f(lineX, height)), top = project(Point2f(lineX, 0));
+    truth.lineX = bottom.x + (top.x - bottom.x) * (bottom.y - bandY) / (bottom.y - top.y);
+
+    /// Balls stand on the floor, so they are drawn in the picture directly, without perspective.
+    truth.balls.clear();
+    int ballCount = rng.uniform(0, params.maximumBalls + 1);
+    for (int i = 0; i < ballCount; i++){
+        int radius = width * rng.uniform(0.06f, 0.1f);
+        Point centre(rng.uniform(radius, params.size.width - radius), rng.uniform(radius, max(radius + 1, params.size.height / 2)));
+        circle(image, centre, radius, ballColors[rng.uniform(0, 3)], FILLED, LINE_AA);
+        Ball ball = {Point2f(centre.x, centre.y), (float)radius};
+        truth.balls.push_back(ball);
+    }
+
+    /// Optics, then the sensor.
+    if (params.blur > 1)
+        GaussianBlur(image, image, Size(params.blur | 1, params.blur | 1), 0);
+    expose(image);
+}
+
+/** Floor point's position in the picture.
+@param point - point on the floor
+@return - point in the picture
+*/
+Point2f SceneGenerator::project(Point2f point) const{
+    const double *h = homography.ptr<double>(0);
+    double w = h[6] * point.x + h[7] * point.y + h[8];
+    return Point2f((h[0] * point.x + h[1] * point.y + h[2]) / w, (h[3] * point.x + h[4] * point.y + h[5]) / w);
+}
+
+/** Read a corpus stored by write().
+@param directory - directory
+@param names - pictures' file names
+@param truths - their content
+@return - success
+*/
+bool SceneGenerator::read(string directory, vector<string> &names, vector<SceneTruth> &truths){
+    if (!directory.empty() && directory[directory.size() - 1] != '/')
+        directory += '/';
+    ifstream file((directory + "truth.txt").c_str());
+    if (!file)
+        return false;
+
+    names.clear();
+    truths.clear();
+    string line;
+    while (getline(file, line)){
+        istringstream in(line);
+        string name;
+        SceneTruth truth;
+        int markers, marker;
+        size_t count;
+        in >> name >> markers >> marker >> truth.lineX >> count;
+        truth.markers = (SceneMarkers)markers;
+        truth.marker = (Marker)marker;
+        for (size_t i = 0; i < count; i++){
+            Ball ball;
+            in >> ball.centre.x >> ball.centre.y >> ball.radius;
+            truth.balls.push_back(ball);
+        }
+        if (!in){
+            cerr << "Corrupt line in truth.txt: " << line << endl;
+            return false;
+        }
+        names.push_back(name);
+        truths.push_back(truth);
+    }
+    return true;
+}
+
+/** Store a corpus: pictures as PNG and ground truth in truth.txt, one line per picture:
+"name markers marker lineX ballCount x y radius...".
+@param directory - existing directory
+@param count - number of pictures
+@return - success
+*/
+bool SceneGenerator::write(string directory, int count){
+    if (!directory.empty() && directory[directory.size() - 1] != '/')
+        directory += '/';
+    ofstream file((directory + "truth.txt").c_str());
+    if (!file){
+        cerr << "Could not write " << directory << "truth.txt" << endl;
+        return false;
+    }
+
+    Mat image;
+    SceneTruth truth;
+    for (int i = 0; i < count; i++){
+        next(image, truth);
+        char name[32];
+        sprintf(name, "%05d.png", i);
+        if (!imwrite(directory + name, image)){
+            cerr << "Could not write " << directory << name << endl;
+            return false;
+        }
+        file << name << " " << truth.markers << " " << truth.marker << " " << truth.lineX << " " << truth.balls.size();
+        for (size_t j = 0; j < truth.balls.size(); j++)
+            file << " " << truth.balls[j].centre.x << " " << truth.balls[j].centre.y << " " << truth.balls[j].radius;
+        file << endl;
+    }
+    return true;
+}
+
+/** Score one picture.
+@param detections - what detectors found
+@param truth - picture's content
+*/
+void SceneScore::add(const Detections &detections, const SceneTruth &truth){
+    const float lineTolerance = 3; /// Pixels
+
+    pictures++;
+    ms += detections.ms;
+
+    /// Marker: with markers on both sides either one is right.
+    if (truth.markers == SCENE_BOTH ? detections.marker != MARKER_NONE : detections.marker == truth.marker)
+        markersRight++;
+
+    if (detections.lineX != -1){
+        linesFound++;
+        float error = fabs(detections.lineX - truth.lineX);
+        lineError += error;
+        if (error > lineTolerance)
+            linesWrong++;
+    }
+
+    /// A ball is found if a detected one is nearer than a quarter of its radius.
+    ballsTrue += truth.balls.size();
+    ballsFound += detections.balls.size();
+    for (size_t j = 0; j < truth.balls.size(); j++)
+        for (size_t k = 0; k < detections.balls.size(); k++)
+            if (hypot(truth.balls[j].centre.x - detections.balls[k].centre.x, truth.balls[j].centre.y - detections.balls[k].centre.y) <=
+                max(2.0f, truth.balls[j].radius / 4)){
+                ballsMatched++;
+                break;
+            }
+}
+
+/** One number for comparing parameter sets: mean of marker, line and ball rates, false balls subtracted.
+@return - 0 to 1, more is better.
+*/
+double SceneScore::accuracy() const{
+    if (pictures == 0)
+        return 0;
+    double markers = (double)markersRight / pictures;
+    double lines = (double)(linesFound - linesWrong) / pictures;
+    double balls = ballsTrue == 0 ? 1 : (double)ballsMatched / ballsTrue;
+    double falseBalls = (double)(ballsFound - min(ballsFound, ballsMatched)) / pictures;
+    return max(0.0, (markers + lines + balls) / 3 - falseBalls / 3);
+}
+
+/** Print the score.
+*/
+void SceneScore::print() const{
+    if (pictures == 0)
+        return;
+    cout << "Markers: " << markersRight << " of " << pictures << " right (" << round(markersRight * 100.0 / pictures) << "%)." << endl;
+    cout << "Line: found in " << linesFound << " pictures";
+    if (linesFound > 0)
+        cout << ", mean error " << lineError / linesFound << " px, " << linesWrong << " off by more than 3 px";
+    cout << "." << endl;
+    cout << "Balls: " << ballsMatched << " of " << ballsTrue << " found, " << (ballsFound - min(ballsFound, ballsMatched)) << " false." << endl;
+    cout << "Speed: " << ms / pictures << " ms per picture." << endl;
+}
@@ -0,0 +1,117 @@
+#ifndef SCENEGENERATOR_H_INCLUDED
+#define SCENEGENERATOR_H_INCLUDED
+#include "Detector.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace cv;
+
+/** Green markers at a crossing, below the horizontal line.
+*/
+enum SceneMarkers {SCENE_NO_MARKER, SCENE_LEFT, SCENE_RIGHT, SCENE_BOTH};
+
+/** Imaging conditions of synthetic pictures. Scene content (line position, markers, balls) is random.
+*/
+struct SceneParams{
+    Size size = Size(160, 120); /// Picture's size
+    float brightness = 1; /// Light: 1 is nominal, less is darker.
+    float gradient = 0; /// Light falling from left to right: 0 is uniform, 0.5 means 25% brighter on the left and 25% darker on the right.
+    float noise = 0; /// Gaussian noise's standard deviation, gray levels
+    int blur = 0; /// Gaussian blur's kernel size, 0 for none. Odd.
+    float perspective = 0; /// Upper edge of the floor narrowed by this part of the width, 0 for a camera looking straight down.
+    int maximumBalls = 2; /// Balls in a picture, 0 to this.
+    uint32_t seed = 1; /// Random generator's seed, the same seed gives the same pictures.
+};
+
+/** Exact content of a synthetic picture.
+*/
+struct SceneTruth{
+    SceneMarkers markers = SCENE_NO_MARKER; /// Markers' configuration
+    Marker marker = MARKER_NONE; /// What crossing detection should report. For SCENE_BOTH either side is right.
+    std::vector<Point2f> markerCentres; /// Markers' centres in the whole picture
+    float lineX = -1; /// Vertical line's centre in the middle of the cropped picture's bottom quarter, where stageLine() measures it
+    std::vector<Ball> balls; /// Balls in the whole picture
+};
+
+/** Detections' accuracy against ground truth, summed over pictures.
+*/
+struct SceneScore{
+    uint32_t pictures = 0; /// Pictures scored
+    uint32_t markersRight = 0; /// Marker decisions matching the truth. For SCENE_BOTH either side is right.
+    uint32_t linesFound = 0; /// Pictures with a line found
+    uint32_t linesWrong = 0; /// Lines found farther than the tolerance
+    double lineError = 0; /// Sum of found lines' errors, pixels
+    uint32_t ballsTrue = 0; /// Balls in the pictures
+    uint32_t ballsFound = 0; /// Balls detected
+    uint32_t ballsMatched = 0; /// Detected balls nearer to a true one than a quarter of its radius
+    double ms = 0; /// Sum of processing times
+
+    /** Score one picture.
+    @param detections - what detectors found
+    @param truth - picture's content
+    */
+    void add(const Detections &detections, const SceneTruth &truth);
+
+    /** One number for comparing parameter sets: mean of marker, line and ball rates, false balls subtracted.
+    @return - 0 to 1, more is better.
+    */
+    double accuracy() const;
+
+    /** Print the score.
+    */
+    void print() const;
+};
+
+/** Renders RoboCup Line pictures: a crossing of black lines on a white floor, green markers in any of the 4 configurations and colored balls,
+under chosen lighting, noise, blur and perspective, with exact ground truth. Used as a frame source instead of the camera.
+*/
+class SceneGenerator{
+    public:
+        /** Constructor
+        @param params - imaging conditions
+        */
+        SceneGenerator(SceneParams params = SceneParams());
+
+        /** Render the next picture.
+        @param image - BGR picture
+        @param truth - its content
+        */
+        void next(Mat &image, SceneTruth &truth);
+
+        /** Read a corpus stored by write().
+        @param directory - directory
+        @param names - pictures' file names
+        @param truths - their content
+        @return - success
+        */
+        static bool read(std::string directory, std::vector<std::string> &names, std::vector<SceneTruth> &truths);
+
+        /** Store a corpus: pictures as PNG and ground truth in truth.txt, one line per picture:
+        "name markers marker lineX ballCount x y radius...".
+        @param directory - existing directory
+        @param count - number of pictures
+        @return - success
+        */
+        bool write(std::string directory, int count);
+
+    private:
+        Mat floor; /// Workspace: floor seen from above
+        Mat homography; /// Floor to picture
+        SceneParams params; /// Imaging conditions
+        RNG rng; /// Random generator
+
+        /** Lighting and noise, in place.
+        @param image - BGR picture
+        */
+        void expose(Mat &image);
+
+        /** Floor point's position in the picture.
+        @param point - point on the floor
+        @return - point in the picture
+        */
+        Point2f project(Point2f point) const;
+};
+
+#endif // SCENEGENERATOR_H_INCLUDED
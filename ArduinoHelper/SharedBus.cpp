@@ -0,0 +1,301 @@
+#include "SharedBus.h"
+#include <climits>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <wiringPi.h>
+
+#define BUS_MAGIC 0x4D524D53 /// "MRMS"
+#define BUS_ALIGNMENT 64 /// Slots and payloads start at cache line boundaries
+#define BUS_REOPEN_CHECK_MS 500 /// Consumers check for a restarted producer at most this often.
+
+using namespace std;
+using namespace cv;
+
+/** Fill from detections. Blobs and balls beyond capacity are dropped.
+@param detections - found objects
+@param frame - frame number
+@param captureTimeMs - frame's capture time
+@param width - cropped picture's width
+*/
+void DetectionRecord::set(const Detections &detections, uint32_t frame, uint32_t captureTimeMs, int width){
+    frameNumber = frame;
+    captureMs = captureTimeMs;
+    marker = detections.marker;
+    lineX = detections.lineX;
+    cols = width;
+    blobCount = min(detections.blobs.size(), (size_t)BUS_MAXIMUM_BLOBS);
+    for (uint8_t i = 0; i < blobCount; i++){
+        blobs[i][0] = detections.blobs[i].centre.x;
+        blobs[i][1] = detections.blobs[i].centre.y;
+    }
+    ballCount = min(detections.balls.size(), (size_t)BUS_MAXIMUM_BALLS);
+    for (uint8_t i = 0; i < ballCount; i++){
+        balls[i][0] = detections.balls[i].centre.x;
+        balls[i][1] = detections.balls[i].centre.y;
+        balls[i][2] = detections.balls[i].radius;
+    }
+    ms = detections.ms;
+}
+
+/** Destructor. The producer also removes the object.
+*/
+SharedMemory::~SharedMemory(){
+    if (head != 0)
+        munmap(head, mappedBytes);
+    if (owner)
+        shm_unlink(name.c_str());
+}
+
+/** Create (producer) or open (consumer) the shared memory.
+@param name - object's name, for example "/mrms-frames"
+@param create - create as producer
+@param slotCount - number of slots, only for producer
+@param slotBytes - payload bytes for each slot, only for producer
+@return - success
+*/
+bool SharedMemory::map(const string &nameNow, bool create, uint32_t slotCount, uint32_t slotBytes){
+    name = nameNow;
+    int handle;
+    size_t bytes;
+    struct stat status;
+    if (create){
+        shm_unlink(name.c_str()); /// Left by a crashed producer
+        handle = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+        slotBytes = (BUS_ALIGNMENT + slotBytes + BUS_ALIGNMENT - 1) / BUS_ALIGNMENT * BUS_ALIGNMENT;
+        bytes = BUS_ALIGNMENT + (size_t)slotCount * slotBytes;
+        if (handle < 0 || ftruncate(handle, bytes) != 0 || fstat(handle, &status) != 0){
+            cerr << "Error creating shared memory " << name << endl;
+            if (handle >= 0)
+                close(handle);
+            return false;
+        }
+    }
+    else{
+        handle = shm_open(name.c_str(), O_RDWR, 0666);
+        if (handle < 0 || fstat(handle, &status) != 0){
+            if (handle >= 0)
+                close(handle);
+            return false; /// Producer not running yet.
+        }
+        bytes = status.st_size;
+    }
+
+    void *memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+    close(handle);
+    if (memory == MAP_FAILED){
+        cerr << "Error mapping shared memory " << name << endl;
+        return false;
+    }
+    Head *mapped = (Head*)memory;
+
+    if (create){
+        owner = true;
+        memset(memory, 0, bytes);
+        mapped->slotCount = slotCount;
+        mapped->slotBytes = slotBytes;
+        mapped->published = 0;
+        atomic_thread_fence(memory_order_release);
+        mapped->magic = BUS_MAGIC;
+    }
+    else if (mapped->magic != BUS_MAGIC || BUS_ALIGNMENT + (size_t)mapped->slotCount * mapped->slotBytes > bytes){
+        munmap(memory, bytes);
+        return false; /// Producer still initializing. A previous mapping, if any, stays.
+    }
+
+    if (head != 0)
+        munmap(head, mappedBytes); /// Replaced by a restarted producer's object
+    head = mapped;
+    mappedBytes = bytes;
+    inode = status.st_ino;
+    return true;
+}
+
+/** Publication done, wake all the consumers.
+@param number - publication's number
+*/
+void SharedMemory::notify(uint32_t number){
+    head->published.store(number, memory_order_release);
+    syscall(SYS_futex, (uint32_t*)&head->published, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+}
+
+/** Number of the last publication.
+@return - number, 0 if none yet.
+*/
+uint32_t SharedMemory::published(){
+    return head->published.load(memory_order_acquire);
+}
+
+/** Consumer: if the producer was restarted, its object was replaced by a new one. Map the new one.
+@return - remapped
+*/
+bool SharedMemory::reopen(){
+    if (owner || millis() - lastCheckMs < BUS_REOPEN_CHECK_MS)
+        return false;
+    lastCheckMs = millis();
+
+    int handle = shm_open(name.c_str(), O_RDONLY, 0);
+    struct stat status;
+    bool replaced = handle >= 0 && fstat(handle, &status) == 0 && status.st_ino != inode;
+    if (handle >= 0)
+        close(handle);
+    if (replaced && map(name, false, 0, 0)){
+        cerr << "Shared memory " << name << " reopened, its producer was restarted." << endl;
+        return true;
+    }
+    return false;
+}
+
+/** Slot
+@param index - slot's index
+@return - slot
+*/
+BusSlot *SharedMemory::slot(uint32_t index){
+    return (BusSlot*)((uint8_t*)head + BUS_ALIGNMENT + (size_t)index * head->slotBytes);
+}
+
+/** Block until something newer than lastSeen is published. On a timeout, a consumer checks whether the producer was restarted and
+then maps the new object. Numbers start again from 1 after that, so a published() smaller than lastSeen means a restart.
+@param lastSeen - last number the consumer processed
+@param timeoutMs - maximum wait
+@return - something new is there
+*/
+bool SharedMemory::wait(uint32_t lastSeen, uint32_t timeoutMs){
+    if (published() != lastSeen)
+        return true;
+    struct timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    syscall(SYS_futex, (uint32_t*)&head->published, FUTEX_WAIT, lastSeen, &timeout, 0, 0);
+    if (published() != lastSeen)
+        return true;
+    return reopen() && published() != lastSeen;
+}
+
+/** Create, as the producer.
+@param maximumBytes - maximum picture size in bytes.
+@return - success
+*/
+bool FrameBus::create(uint32_t maximumBytes){
+    return map("/mrms-frames", true, BUS_FRAME_SLOTS, maximumBytes);
+}
+
+/** Latest frame. The picture points directly into shared memory, it is not copied. Call valid() after processing to check that the
+producer did not overwrite it meanwhile.
+@param image - picture
+@param number - frame number. Pass it later to valid().
+@param captureMs - capture time
+@return - a frame is available
+*/
+bool FrameBus::latest(Mat &image, uint32_t &number, uint32_t &captureMs){
+    for (uint8_t attempt = 0; attempt < 3; attempt++){
+        number = published();
+        if (number == 0)
+            return false;
+        BusSlot *frame = slot(number % head->slotCount);
+        readSequence = frame->sequence.load(memory_order_acquire);
+        if (readSequence & 1 || frame->number != number)
+            continue; /// Being overwritten, try the newer one.
+        captureMs = frame->captureMs;
+        image = Mat(frame->rows, frame->cols, frame->type, (uint8_t*)frame + BUS_ALIGNMENT);
+        return true;
+    }
+    return false;
+}
+
+/** Open, as a consumer.
+@return - success
+*/
+bool FrameBus::open(){
+    return map("/mrms-frames", false, 0, 0);
+}
+
+/** Publish a frame.
+@param image - picture
+@param captureMs - capture time
+@return - frame number
+*/
+uint32_t FrameBus::publish(const Mat &image, uint32_t captureMs){
+    size_t bytes = image.total() * image.elemSize();
+    if (bytes > head->slotBytes - BUS_ALIGNMENT || !image.isContinuous()){
+        cerr << "Frame too big for the bus." << endl;
+        return 0;
+    }
+
+    uint32_t number = head->published.load(memory_order_relaxed) + 1;
+    BusSlot *frame = slot(number % head->slotCount);
+    uint32_t sequence = frame->sequence.load(memory_order_relaxed);
+    frame->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy((uint8_t*)frame + BUS_ALIGNMENT, image.data, bytes);
+    frame->number = number;
+    frame->captureMs = captureMs;
+    frame->rows = image.rows;
+    frame->cols = image.cols;
+    frame->type = image.type();
+    frame->sequence.store(sequence + 2, memory_order_release);
+
+    notify(number);
+    return number;
+}
+
+/** Check that a frame obtained with latest() was not overwritten.
+@param number - frame number
+@return - still valid
+*/
+bool FrameBus::valid(uint32_t number){
+    atomic_thread_fence(memory_order_acquire);
+    return slot(number % head->slotCount)->sequence.load(memory_order_relaxed) == readSequence;
+}
+
+/** Create, as the producer.
+@return - success
+*/
+bool DetectionBus::create(){
+    return map("/mrms-detections", true, BUS_DETECTION_SLOTS, sizeof(DetectionRecord));
+}
+
+/** Open, as a consumer.
+@return - success
+*/
+bool DetectionBus::open(){
+    return map("/mrms-detections", false, 0, 0);
+}
+
+/** Publish detections.
+@param record - detections
+*/
+void DetectionBus::publish(const DetectionRecord &record){
+    uint32_t number = head->published.load(memory_order_relaxed) + 1;
+    BusSlot *entry = slot(number % head->slotCount);
+    uint32_t sequence = entry->sequence.load(memory_order_relaxed);
+    entry->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy((uint8_t*)entry + BUS_ALIGNMENT, &record, sizeof(record));
+    entry->number = number;
+    entry->captureMs = record.captureMs;
+    entry->sequence.store(sequence + 2, memory_order_release);
+
+    notify(number);
+}
+
+/** Read a publication.
+@param number - publication's number, 1 for the first one.
+@param record - detections
+@return - success, false if overwritten or not published yet.
+*/
+bool DetectionBus::read(uint32_t number, DetectionRecord &record){
+    BusSlot *entry = slot(number % head->slotCount);
+    uint32_t sequence = entry->sequence.load(memory_order_acquire);
+    if (sequence & 1 || entry->number != number)
+        return false;
+    memcpy(&record, (uint8_t*)entry + BUS_ALIGNMENT, sizeof(record));
+    atomic_thread_fence(memory_order_acquire);
+    return entry->sequence.load(memory_order_relaxed) == sequence;
+}
@@ -0,0 +1,180 @@
+#ifndef SHAREDBUS_H_INCLUDED
+#define SHAREDBUS_H_INCLUDED
+#include "Detector.h"
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+
+#define BUS_FRAME_SLOTS 4
+#define BUS_DETECTION_SLOTS 64
+#define BUS_MAXIMUM_BLOBS 8
+#define BUS_MAXIMUM_BALLS 4
+
+/** Detections of one frame in a fixed size, so they can be stored in shared memory.
+*/
+struct DetectionRecord{
+    uint32_t frameNumber; /// Frame the detections belong to
+    uint32_t captureMs; /// Frame's capture time, millis()
+    int32_t marker; /// Marker
+    int16_t lineX; /// Line's position in the cropped picture, -1 if not found
+    int16_t cols; /// Cropped picture's width, the range of lineX
+    uint8_t blobCount; /// Valid entries in blobs
+    uint8_t ballCount; /// Valid entries in balls
+    int16_t blobs[BUS_MAXIMUM_BLOBS][2]; /// Blobs' centres: x, y
+    float balls[BUS_MAXIMUM_BALLS][3]; /// Balls: x, y, radius
+    float ms; /// Processing time
+
+    /** Fill from detections. Blobs and balls beyond capacity are dropped.
+    @param detections - found objects
+    @param frame - frame number
+    @param captureTimeMs - frame's capture time
+    @param width - cropped picture's width
+    */
+    void set(const Detections &detections, uint32_t frame, uint32_t captureTimeMs, int width);
+};
+
+/** Part of shared memory describing a slot: a seqlock. Sequence is odd while the slot is being written.
+*/
+struct BusSlot{
+    std::atomic<uint32_t> sequence; /// Seqlock
+    uint32_t number; /// Frame or record number
+    uint32_t captureMs; /// Capture time, millis()
+    int32_t rows; /// Picture's height
+    int32_t cols; /// Picture's width
+    int32_t type; /// OpenCV type
+};
+
+/** Base of the buses: a POSIX shared memory object with a futex that counts publications. One process creates it (the producer), others open it.
+*/
+class SharedMemory{
+    public:
+        /** Destructor. The producer also removes the object.
+        */
+        virtual ~SharedMemory();
+
+        /** Number of the last publication.
+        @return - number, 0 if none yet.
+        */
+        uint32_t published();
+
+        /** Block until something newer than lastSeen is published. On a timeout, a consumer checks whether the producer was restarted and
+        then maps the new object. Numbers start again from 1 after that, so a published() smaller than lastSeen means a restart.
+        @param lastSeen - last number the consumer processed
+        @param timeoutMs - maximum wait
+        @return - something new is there
+        */
+        bool wait(uint32_t lastSeen, uint32_t timeoutMs = 100);
+
+    protected:
+        /** Head of shared memory.
+        */
+        struct Head{
+            uint32_t magic; /// Initialized
+            uint32_t slotCount; /// Number of slots
+            uint32_t slotBytes; /// Bytes for each slot, including BusSlot
+            std::atomic<uint32_t> published; /// Futex word: number of the last publication
+        };
+
+        Head *head = 0; /// Mapped memory
+        ino_t inode = 0; /// Mapped object's inode. A restarted producer creates a new one.
+        uint32_t lastCheckMs = 0; /// Last check for a restarted producer, millis()
+        size_t mappedBytes = 0; /// Mapped size
+        std::string name; /// Object's name
+        bool owner = false; /// Created by this process
+
+        /** Slot
+        @param index - slot's index
+        @return - slot
+        */
+        BusSlot *slot(uint32_t index);
+
+        /** Create (producer) or open (consumer) the shared memory.
+        @param name - object's name, for example "/mrms-frames"
+        @param create - create as producer
+        @param slotCount - number of slots, only for producer
+        @param slotBytes - payload bytes for each slot, only for producer
+        @return - success
+        */
+        bool map(const std::string &name, bool create, uint32_t slotCount, uint32_t slotBytes);
+
+        /** Consumer: if the producer was restarted, its object was replaced by a new one. Map the new one.
+        @return - remapped
+        */
+        bool reopen();
+
+        /** Publication done, wake all the consumers.
+        @param number - publication's number
+        */
+        void notify(uint32_t number);
+};
+
+/** Frames from the camera, published once and read by any number of processes without copying.
+*/
+class FrameBus : public SharedMemory{
+    public:
+        /** Create, as the producer.
+        @param maximumBytes - maximum picture size in bytes.
+        @return - success
+        */
+        bool create(uint32_t maximumBytes = 640 * 480 * 3);
+
+        /** Latest frame. The picture points directly into shared memory, it is not copied. Call valid() after processing to check that the
+        producer did not overwrite it meanwhile.
+        @param image - picture
+        @param number - frame number. Pass it later to valid().
+        @param captureMs - capture time
+        @return - a frame is available
+        */
+        bool latest(Mat &image, uint32_t &number, uint32_t &captureMs);
+
+        /** Open, as a consumer.
+        @return - success
+        */
+        bool open();
+
+        /** Publish a frame.
+        @param image - picture
+        @param captureMs - capture time
+        @return - frame number
+        */
+        uint32_t publish(const Mat &image, uint32_t captureMs);
+
+        /** Check that a frame obtained with latest() was not overwritten.
+        @param number - frame number
+        @return - still valid
+        */
+        bool valid(uint32_t number);
+
+    private:
+        uint32_t readSequence = 0; /// Seqlock value seen by latest()
+};
+
+/** Detections, published by a vision worker and read by other processes.
+*/
+class DetectionBus : public SharedMemory{
+    public:
+        /** Create, as the producer.
+        @return - success
+        */
+        bool create();
+
+        /** Open, as a consumer.
+        @return - success
+        */
+        bool open();
+
+        /** Publish detections.
+        @param record - detections
+        */
+        void publish(const DetectionRecord &record);
+
+        /** Read a publication.
+        @param number - publication's number, 1 for the first one.
+        @param record - detections
+        @return - success, false if overwritten or not published yet.
+        */
+        bool read(uint32_t number, DetectionRecord &record);
+};
+
+#endif // SHAREDBUS_H_INCLUDED
@@ -0,0 +1,130 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+thread_local const ThreadPool *ownPool = 0; /// Pool of the current worker thread, 0 outside any pool.
+thread_local int ownQueue = -1; /// Queue of the current worker thread in ownPool, -1 outside any pool.
+
+/** Constructor
+@param workerCount - number of threads. 0 for one less than the number of cores, as the caller works too.
+*/
+ThreadPool::ThreadPool(unsigned workerCount){
+    if (workerCount == 0){
+        unsigned cores = thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+    running = true;
+    queued = 0;
+    nextQueue = 0;
+    for (unsigned i = 0; i < workerCount; i++)
+        queues.push_back(new Queue());
+    for (unsigned i = 0; i < workerCount; i++)
+        workers.push_back(thread(&ThreadPool::work, this, i));
+}
+
+/** Destructor. Waits for the workers to finish.
+*/
+ThreadPool::~ThreadPool(){
+    {
+        lock_guard<mutex> guard(idleLock);
+        running = false;
+    }
+    available.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    for (size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+}
+
+/** Execute a task and notify its group.
+@param task - task
+*/
+void ThreadPool::execute(Task &task){
+    task.function();
+    task.group->pending--;
+}
+
+/** Add a task.
+@param group - the task belongs to this group.
+@param task - function
+*/
+void ThreadPool::run(TaskGroup &group, function<void()> function){
+    group.pending++;
+    Task task = {function, &group};
+    int own = ownPool == this ? ownQueue : -1; /// Another pool's worker is an outside caller here.
+    Queue &queue = *queues[own >= 0 ? own : nextQueue++ % queues.size()];
+    {
+        lock_guard<mutex> guard(queue.lock);
+        queue.tasks.push_back(task);
+    }
+    {
+        lock_guard<mutex> guard(idleLock);
+        queued++;
+    }
+    available.notify_one();
+}
+
+/** Take a task: own queue's newest first, then the oldest from other queues.
+@param own - own queue, or -1 for a thread outside the pool.
+@param task - task taken
+@return - found
+*/
+bool ThreadPool::take(int own, Task &task){
+    if (own >= 0){
+        Queue &queue = *queues[own];
+        lock_guard<mutex> guard(queue.lock);
+        if (!queue.tasks.empty()){
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    size_t first = own >= 0 ? own + 1 : 0;
+    for (size_t i = 0; i < queues.size(); i++){
+        size_t index = (first + i) % queues.size();
+        if ((int)index == own)
+            continue;
+        Queue &queue = *queues[index];
+        lock_guard<mutex> guard(queue.lock);
+        if (!queue.tasks.empty()){
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Execute tasks until all the tasks in the group are finished.
+@param group - group
+*/
+void ThreadPool::wait(TaskGroup &group){
+    Task task;
+    while (!group.done()){
+        if (take(ownPool == this ? ownQueue : -1, task))
+            execute(task);
+        else
+            this_thread::yield(); /// The last tasks are being executed by others.
+    }
+}
+
+/** Worker's loop.
+@param index - worker's index, also its queue's index.
+*/
+void ThreadPool::work(int index){
+    ownPool = this;
+    ownQueue = index;
+    Task task;
+    while (true){
+        if (take(index, task)){
+            execute(task);
+            continue;
+        }
+        unique_lock<mutex> guard(idleLock);
+        available.wait(guard, [this]{ return !running || queued > 0;});
+        if (!running)
+            return;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef THREADPOOL_H_INCLUDED
+#define THREADPOOL_H_INCLUDED
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Tasks that must all finish before the caller continues (a join point in the task graph).
+*/
+class TaskGroup{
+    public:
+        TaskGroup(){ pending = 0;}
+
+        /** All tasks finished.
+        @return - finished
+        */
+        bool done(){ return pending == 0;}
+
+    private:
+        friend class ThreadPool;
+        std::atomic<int> pending; /// Tasks not finished yet
+};
+
+/** Small work-stealing pool. Each worker has its own queue: it takes its newest task first and, when idle, steals the oldest ones from others.
+A thread waiting for a group executes tasks too, so no core idles at a join.
+*/
+class ThreadPool{
+    public:
+        /** Constructor
+        @param workerCount - number of threads. 0 for one less than the number of cores, as the caller works too.
+        */
+        ThreadPool(unsigned workerCount = 0);
+
+        /** Destructor. Waits for the workers to finish.
+        */
+        ~ThreadPool();
+
+        /** Add a task.
+        @param group - the task belongs to this group.
+        @param task - function
+        */
+        void run(TaskGroup &group, std::function<void()> task);
+
+        /** Execute tasks until all the tasks in the group are finished.
+        @param group - group
+        */
+        void wait(TaskGroup &group);
+
+    private:
+        /** A queued task.
+        */
+        struct Task{
+            std::function<void()> function; /// Work
+            TaskGroup *group; /// Group to notify
+        };
+
+        /** A worker's queue.
+        */
+        struct Queue{
+            std::deque<Task> tasks; /// Tasks
+            std::mutex lock; /// Guards tasks
+        };
+
+        std::condition_variable available; /// Signals new tasks or stop
+        std::mutex idleLock; /// For available
+        std::atomic<unsigned> nextQueue; /// Round-robin for tasks from outside
+        std::vector<Queue*> queues; /// One for each worker
+        std::atomic<bool> running; /// Workers should continue
+        std::atomic<int> queued; /// Tasks waiting in all queues
+        std::vector<std::thread> workers; /// Threads
+
+        /** Execute a task and notify its group.
+        @param task - task
+        */
+        void execute(Task &task);
+
+        /** Take a task: own queue's newest first, then the oldest from other queues.
+        @param own - own queue, or -1 for a thread outside the pool.
+        @param task - task taken
+        @return - found
+        */
+        bool take(int own, Task &task);
+
+        /** Worker's loop.
+        @param index - worker's index, also its queue's index.
+        */
+        void work(int index);
+};
+
+#endif // THREADPOOL_H_INCLUDED
@@ -0,0 +1,222 @@
+#include "Tuner.h"
+#include "Detector.h"
+#include <algorithm>
+#include <iostream>
+#include <opencv2/highgui/highgui.hpp>
+#include <wiringPi.h>
+
+using namespace std;
+using namespace cv;
+
+#define TUNER_REPEAT_NOISE 4 /// Sensor noise added to the repeated pictures: 0 to this, gray levels.
+
+/** A value near another one.
+@param rng - random generator
+@param value - centre
+@param spread - maximum difference
+@param low - lower limit
+@param high - upper limit
+@return - value
+*/
+static int around(RNG &rng, int value, int spread, int low, int high){
+    return max(low, min(high, value + rng.uniform(-spread, spread + 1)));
+}
+
+/** A value near another one.
+@param rng - random generator
+@param value - centre
+@param spread - maximum difference
+@param low - lower limit
+@param high - upper limit
+@return - value
+*/
+static float around(RNG &rng, float value, float spread, float low, float high){
+    return max(low, min(high, value + rng.uniform(-spread, spread)));
+}
+
+/** Constructor
+@param base - starting parameters, always evaluated as the first candidate. The others are random variations of it.
+@param yuv - crossing detection on YUV pictures, scoring the YUV parameters.
+*/
+Tuner::Tuner(DetectorParams baseNow, bool yuvNow){
+    base = baseNow;
+    yuv = yuvNow;
+}
+
+/** Use a corpus stored by SceneGenerator::write() or labelled the same way.
+@param directory - directory with pictures and truth.txt
+@return - success
+*/
+bool Tuner::corpusLoad(string directory){
+    vector<string> names;
+    if (!SceneGenerator::read(directory, names, truths))
+        return false;
+    if (!directory.empty() && directory[directory.size() - 1] != '/')
+        directory += '/';
+
+    images.clear();
+    for (size_t i = 0; i < names.size(); i++){
+        images.push_back(imread(directory + names[i], IMREAD_COLOR));
+        if (images.back().empty()){
+            cerr << "Could not open or find the image " << names[i] << endl;
+            return false;
+        }
+    }
+    cout << "Corpus: " << images.size() << " pictures from " << directory << "." << endl;
+    prepare();
+    return true;
+}
+
+/** Use synthetic pictures.
+@param params - imaging conditions
+@param count - number of pictures
+*/
+void Tuner::corpusSynthetic(SceneParams params, int count){
+    SceneGenerator generator(params);
+    images.assign(count, Mat());
+    truths.assign(count, SceneTruth());
+    for (int i = 0; i < count; i++)
+        generator.next(images[i], truths[i]);
+    cout << "Corpus: " << count << " synthetic pictures." << endl;
+    prepare();
+}
+
+/** Score a candidate over the whole corpus. Uses its own Detector.
+@param candidate - parameters in, score out.
+*/
+void Tuner::evaluate(Candidate &candidate){
+    Detector detector;
+    detector.paramsSet(candidate.params);
+    detector.changeDetectionEnable(true);
+    const Scalar &low = candidate.params.ballLow, &high = candidate.params.ballHigh;
+    Detections detections, balls;
+    for (size_t i = 0; i < images.size(); i++){
+        detector.circles(images[i], low[0], high[0], low[1], high[1], low[2], high[2], balls);
+
+        /// The picture, then the static repeat. Balls are not change-detected, both get the same ones, timed once.
+        for (int repeat = 0; repeat < 2; repeat++){
+            const Mat &picture = repeat == 0 ? crossingImages[i] : crossingRepeats[i];
+            if (yuv)
+                detector.crossingYuv(picture, detections);
+            else
+                detector.crossing(picture, detections);
+            detections.balls = balls.balls;
+            if (repeat == 0)
+                detections.ms += balls.ms;
+            candidate.score.add(detections, truths[i]);
+        }
+    }
+}
+
+/** Prepare the corpus' crossing pictures and their repeats.
+*/
+void Tuner::prepare(){
+    RNG rng(2);
+    crossingImages.assign(images.size(), Mat());
+    crossingRepeats.assign(images.size(), Mat());
+    for (size_t i = 0; i < images.size(); i++){
+        Mat noise(images[i].size(), images[i].type()), repeat;
+        randu(noise, Scalar::all(0), Scalar::all(TUNER_REPEAT_NOISE + 1));
+        add(images[i], noise, repeat);
+        if (yuv){
+            cvtColor(images[i], crossingImages[i], COLOR_BGR2YUV_I420);
+            cvtColor(repeat, crossingRepeats[i], COLOR_BGR2YUV_I420);
+        }
+        else{
+            crossingImages[i] = images[i];
+            crossingRepeats[i] = repeat;
+        }
+    }
+}
+
+/** Random variation of the base parameters, within sensible ranges.
+@param rng - random generator
+@return - parameters
+*/
+DetectorParams Tuner::random(RNG &rng){
+    DetectorParams params = base;
+    params.cannyThreshold = around(rng, base.cannyThreshold, 30, 10, 250);
+    params.greenLow = Scalar(around(rng, (int)base.greenLow[0], 8, 0, 179), base.greenLow[1], around(rng, (int)base.greenLow[2], 15, 0, 255));
+    params.greenHigh = Scalar(around(rng, (int)base.greenHigh[0], 8, 0, 179), base.greenHigh[1],
+        around(rng, (int)base.greenHigh[2], 25, 0, 255));
+    params.greenKernel = around(rng, base.greenKernel / 2, 1, 1, 4) * 2 + 1; /// Odd
+    params.blackMaximumV = around(rng, base.blackMaximumV, 15, 10, 120);
+    params.yuvBlackMaximumY = around(rng, base.yuvBlackMaximumY, 15, 10, 120);
+    params.yuvGreenMaximumU = around(rng, base.yuvGreenMaximumU, 8, 90, 127);
+    params.yuvGreenMaximumV = around(rng, base.yuvGreenMaximumV, 8, 90, 127);
+    params.blobAreaDivisor = max(500, min(64000, base.blobAreaDivisor << rng.uniform(0, 3) >> 1)); /// Half, same or double
+    params.blackFill = around(rng, base.blackFill, 0.15f, 0.2f, 0.8f);
+    params.ballLow = Scalar(base.ballLow[0], base.ballLow[1], around(rng, (int)base.ballLow[2], 20, 0, 255));
+    params.ballHigh = Scalar(base.ballHigh[0], base.ballHigh[1], around(rng, (int)base.ballHigh[2], 30, 0, 255));
+    params.ballKernel = around(rng, base.ballKernel / 2, 1, 1, 4) * 2 + 1;
+    if (rng.uniform(0, 4) == 0)
+        params.ballEngine = base.ballEngine == BALLS_HOUGH ? BALLS_CONTOUR : BALLS_HOUGH; /// Sometimes the other engine
+
+    /// Only the chosen engine's parameters, the other one's would only make duplicates.
+    if (params.ballEngine == BALLS_HOUGH){
+        params.houghDistanceDivisor = around(rng, base.houghDistanceDivisor, 2, 1, 10);
+        params.houghCanny = around(rng, base.houghCanny, 40, 30, 250);
+        params.houghVotes = around(rng, base.houghVotes, 8, 5, 60);
+        params.houghMinimumRadius = around(rng, base.houghMinimumRadius, 6, 2, 60);
+    }
+    else{
+        params.contourDistanceDivisor = around(rng, base.contourDistanceDivisor, 2, 1, 10);
+        params.contourMinimumRadius = around(rng, base.contourMinimumRadius, 6, 2, 60);
+        params.contourCircularity = around(rng, base.contourCircularity, 0.1f, 0.3f, 0.95f);
+        params.contourFill = around(rng, base.contourFill, 0.1f, 0.3f, 0.95f);
+    }
+    params.changeTile = around(rng, base.changeTile / CHANGE_SCALE, 2, 2, 32) * CHANGE_SCALE; /// Multiple of CHANGE_SCALE
+    params.changeThreshold = around(rng, base.changeThreshold, 2, 1, 30);
+    params.changeRefresh = around(rng, base.changeRefresh, 5, 1, 60);
+    return params;
+}
+
+/** Search.
+@param candidateCount - parameter sets to evaluate, random ones around the base.
+@param budgetMs - time per picture the chosen parameters must fit into.
+@return - chosen parameters
+*/
+DetectorParams Tuner::run(int candidateCount, double budgetMs){
+    if (images.empty()){
+        cerr << "No corpus for tuning." << endl;
+        return base;
+    }
+
+    RNG rng(1);
+    candidates.assign(max(1, candidateCount), Candidate());
+    candidates[0].params = base;
+    for (size_t i = 1; i < candidates.size(); i++)
+        candidates[i].params = random(rng);
+
+    /// One at a time: candidates running in parallel would slow each other down and skew the times.
+    uint32_t startMs = millis();
+    for (size_t i = 0; i < candidates.size(); i++)
+        evaluate(candidates[i]);
+    cout << candidates.size() << " candidates in " << (millis() - startMs) / 1000.0 << " s." << endl;
+
+    /// Pareto frontier: sorted by time, each next one must be more accurate than all the faster ones.
+    vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [this](size_t a, size_t b){ return candidates[a].score.ms < candidates[b].score.ms;});
+    vector<size_t> frontier;
+    for (size_t i = 0; i < order.size(); i++)
+        if (frontier.empty() || candidates[order[i]].score.accuracy() > candidates[frontier.back()].score.accuracy())
+            frontier.push_back(order[i]);
+
+    cout << "Pareto frontier (candidate 0 is the base):" << endl;
+    size_t chosen = frontier[0];
+    for (size_t i = 0; i < frontier.size(); i++){
+        const SceneScore &score = candidates[frontier[i]].score;
+        double ms = score.ms / score.pictures;
+        cout << "  candidate " << frontier[i] << ": accuracy " << score.accuracy() << ", " << ms << " ms per picture" << endl;
+        if (ms <= budgetMs)
+            chosen = frontier[i];
+    }
+
+    const SceneScore &baseScore = candidates[0].score;
+    cout << "Base: accuracy " << baseScore.accuracy() << ", " << baseScore.ms / baseScore.pictures << " ms per picture." << endl;
+    cout << "Chosen candidate " << chosen << ", budget " << budgetMs << " ms:" << endl;
+    candidates[chosen].score.print();
+    return candidates[chosen].params;
+}
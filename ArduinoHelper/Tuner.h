@@ -0,0 +1,75 @@
+#ifndef TUNER_H_INCLUDED
+#define TUNER_H_INCLUDED
+#include "DetectorParams.h"
+#include "SceneGenerator.h"
+#include <string>
+#include <vector>
+
+/** Searches detector parameters over a labelled corpus, candidates evaluated one at a time, so each one's time is free of the others'
+contention. Each candidate is scored for accuracy against ground truth and for time per picture. Candidates on the Pareto frontier (no other one both more accurate and faster) are
+reported and the most accurate one fitting the time budget is chosen.
+The corpus is processed as a stream with change detection on: each picture, then the same one again with new sensor noise, as a static
+scene. So change detection's parameters are scored too: too sensitive wastes time on the repeats, too dull reuses a different picture's
+results.
+Runs uncalibrated, without FLOOR_CALIBRATION, as the corpus may come from another camera or from SceneGenerator.
+*/
+class Tuner{
+    public:
+        /** Constructor
+        @param base - starting parameters, always evaluated as the first candidate. The others are random variations of it.
+        @param yuv - crossing detection on YUV pictures, scoring the YUV parameters.
+        */
+        Tuner(DetectorParams base = DetectorParams(), bool yuv = false);
+
+        /** Use a corpus stored by SceneGenerator::write() or labelled the same way.
+        @param directory - directory with pictures and truth.txt
+        @return - success
+        */
+        bool corpusLoad(std::string directory);
+
+        /** Use synthetic pictures.
+        @param params - imaging conditions
+        @param count - number of pictures
+        */
+        void corpusSynthetic(SceneParams params, int count);
+
+        /** Search.
+        @param candidateCount - parameter sets to evaluate, random ones around the base.
+        @param budgetMs - time per picture the chosen parameters must fit into.
+        @return - chosen parameters
+        */
+        DetectorParams run(int candidateCount, double budgetMs);
+
+    private:
+        /** A parameter set and its result.
+        */
+        struct Candidate{
+            DetectorParams params; /// Parameters
+            SceneScore score; /// Accuracy and speed
+        };
+
+        DetectorParams base; /// Starting parameters
+        std::vector<Candidate> candidates; /// Evaluated parameter sets
+        std::vector<Mat> crossingImages; /// Corpus: pictures for crossing detection, BGR or YUV
+        std::vector<Mat> crossingRepeats; /// Corpus: the same again with new sensor noise
+        std::vector<Mat> images; /// Corpus: pictures
+        std::vector<SceneTruth> truths; /// Corpus: their content
+        bool yuv; /// Crossing detection on YUV pictures
+
+        /** Score a candidate over the whole corpus. Uses its own Detector.
+        @param candidate - parameters in, score out.
+        */
+        void evaluate(Candidate &candidate);
+
+        /** Prepare the corpus' crossing pictures and their repeats.
+        */
+        void prepare();
+
+        /** Random variation of the base parameters, within sensible ranges.
+        @param rng - random generator
+        @return - parameters
+        */
+        DetectorParams random(RNG &rng);
+};
+
+#endif // TUNER_H_INCLUDED
@@ -1,6 +1,8 @@
 #include "UART.h"
+#include "Metrics.h"
 #include <fcntl.h>
 #include <iostream>
+#include <string.h>
 #include <unistd.h>
 #include <wiringPi.h>
 #include <wiringSerial.h>
@@ -114,17 +116,17 @@ uint8_t Message::size() {
 
 
 /**Constructor
+@param device - serial port, a pseudo-terminal for replays.
 @param speed - Sets the data rate in bits per second (baud) for serial data transmission. Use one of these rates: 300, 600, 1200, 2400, 4800,
 9600, 14400, 19200, 28800, 38400, 57600, or 115200. The other party must use the same speed.
 */
-UART::UART(uint32_t speed)
+UART::UART(string device, uint32_t speed)
 {
-    char dev[] = "/dev/serial0";
-	if ((_handle = serialOpen(dev, speed)) < 0) {
-		cout << "Error opening " << dev << ". Rights?" << endl;
+	if ((_handle = serialOpen(device.c_str(), speed)) < 0) {
+		cout << "Error opening " << device << ". Rights?" << endl;
 	}
 	else
-		cout << dev << " opened." << endl;
+		cout << device << " opened." << endl;
 }
 
 UART::~UART()
@@ -146,6 +148,9 @@ uint8_t UART::read()
 {
 	try {
 		uint8_t ch = serialGetchar(_handle);
+		Metrics::add(METRIC_UART_RX_BYTES);
+		if (recorder != 0)
+			recorder->record(UART_RX, &ch, 1);
 		return ch;
 	}
 	catch (...) {
@@ -164,6 +169,11 @@ int UART::read(uint8_t size, uint8_t * data)
 
 	try {
 		int bytesReadCount = ::read(_handle, data, size);
+		if (bytesReadCount > 0){
+			Metrics::add(METRIC_UART_RX_BYTES, bytesReadCount);
+			if (recorder != 0)
+				recorder->record(UART_RX, data, bytesReadCount);
+		}
 		return bytesReadCount;
 	}
 	catch (...) {
@@ -195,6 +205,9 @@ void UART::write(uint8_t byte)
 {
 	try {
 		serialPutchar(_handle, byte);
+		Metrics::add(METRIC_UART_TX_BYTES);
+		if (recorder != 0)
+			recorder->record(UART_TX, &byte, 1);
 	}
 	catch (...) {
 		cerr << " Error in write().";
@@ -207,6 +220,9 @@ void UART::write(uint8_t byte)
 void UART::write(char *string){
     try {
 		serialPuts(_handle, string);
+		Metrics::add(METRIC_UART_TX_BYTES, strlen(string));
+		if (recorder != 0)
+			recorder->record(UART_TX, (uint8_t*)string, strlen(string));
 	}
 	catch (...) {
 		cerr << " Error in write().";
@@ -221,6 +237,9 @@ void UART::write(char *string){
 void UART::write(uint8_t size, uint8_t *bytes) {
     try{
 		::write(_handle, bytes, size);
+		Metrics::add(METRIC_UART_TX_BYTES, size);
+		if (recorder != 0)
+			recorder->record(UART_TX, bytes, size);
     }
 	catch (...) {
 		cerr << " Error in write().";
@@ -239,4 +258,5 @@ void UART::write(Message message, bool verbose) {
 		cout << endl;
 	}
 	write(message.size(), message.bytes());
+	Metrics::add(METRIC_UART_TX_MESSAGES);
 }
@@ -1,6 +1,7 @@
 #ifndef UART_H
 #define UART_H
 
+#include "UartRecorder.h"
 #include <stdint.h>
 #include <string>
 
@@ -88,13 +89,15 @@ class UART
 {
     private:
         int _handle; /// Reference to the serial port.
+        UartRecorder *recorder = 0; /// Records traffic, if set.
 
     public:
         /**Constructor
+        @param device - serial port, a pseudo-terminal for replays.
         @param speed - Sets the data rate in bits per second (baud) for serial data transmission. Use one of these rates: 300, 600, 1200, 2400, 4800,
             9600, 14400, 19200, 28800, 38400, 57600, or 115200. The other party must use the same speed.
         */
-        UART(uint32_t speed = 115200);
+        UART(string device = "/dev/serial0", uint32_t speed = 115200);
 
         virtual ~UART();
 
@@ -121,6 +124,11 @@ class UART
         */
         Message readMessage(bool verbose = false);
 
+        /** Record all the traffic from now on.
+        @param sessionRecorder - recorder, already started. 0 stops recording.
+        */
+        void recorderSet(UartRecorder *sessionRecorder){ recorder = sessionRecorder;}
+
         /** Writes a single byte to the serial port.
         @param byte - a byte to send.
         */
@@ -0,0 +1,141 @@
+#include "UartRecorder.h"
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <wiringPi.h>
+
+#define UART_RECORD_MAGIC "MRMSUART" /// Session file's first 8 bytes
+#define UART_RECORD_FLUSH_MS 100 /// Background writer's period
+
+using namespace std;
+
+/** Constructor
+*/
+UartRecorder::UartRecorder() : frames(UART_RECORD_FRAMES){
+    head = 0;
+    tail = 0;
+    recording = false;
+}
+
+/** Destructor, stops recording.
+*/
+UartRecorder::~UartRecorder(){
+    stop();
+}
+
+/** Write recorded frames to the file.
+*/
+void UartRecorder::flush(){
+    uint32_t last = head.load(memory_order_acquire);
+    for (uint32_t i = tail.load(memory_order_relaxed); i != last; i++){
+        const UartFrame &frame = frames[i % UART_RECORD_FRAMES];
+        uint8_t header[6] = {(uint8_t)frame.us, (uint8_t)(frame.us >> 8), (uint8_t)(frame.us >> 16), (uint8_t)(frame.us >> 24), frame.direction,
+            frame.size};
+        fwrite(header, 1, sizeof(header), file);
+        fwrite(frame.bytes, 1, frame.size, file);
+    }
+    tail.store(last, memory_order_release);
+    fflush(file);
+}
+
+/** Background writer's loop.
+*/
+void UartRecorder::loop(){
+    unique_lock<mutex> guard(wakeLock);
+    while (recording){
+        wake.wait_for(guard, chrono::milliseconds(UART_RECORD_FLUSH_MS));
+        flush();
+    }
+}
+
+/** Read a session.
+@param fileName - file
+@param frames - frames read
+@return - success
+*/
+bool UartRecorder::read(const string &fileName, vector<UartFrame> &framesRead){
+    FILE *in = fopen(fileName.c_str(), "rb");
+    if (in == 0)
+        return false;
+    char magic[8];
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, UART_RECORD_MAGIC, sizeof(magic)) != 0){
+        cerr << fileName << " is not a UART session." << endl;
+        fclose(in);
+        return false;
+    }
+
+    framesRead.clear();
+    uint8_t header[6];
+    while (fread(header, 1, sizeof(header), in) == sizeof(header)){
+        UartFrame frame;
+        frame.us = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+        frame.direction = header[4];
+        frame.size = min((int)header[5], UART_RECORD_FRAME_BYTES);
+        if (fread(frame.bytes, 1, frame.size, in) != frame.size)
+            break; /// Cut off while recording
+        framesRead.push_back(frame);
+    }
+    fclose(in);
+    return true;
+}
+
+/** Record a transfer. Called by one thread only, the serial port's.
+@param direction - received or sent
+@param bytes - data
+@param size - number of bytes
+*/
+void UartRecorder::record(UartDirection direction, const uint8_t *bytes, size_t size){
+    if (!recording)
+        return;
+    uint32_t us = micros();
+    uint32_t position = head.load(memory_order_relaxed);
+    for (size_t done = 0; done < size; done += UART_RECORD_FRAME_BYTES){
+        if (position - tail.load(memory_order_acquire) >= UART_RECORD_FRAMES){
+            dropped++;
+            continue;
+        }
+        UartFrame &frame = frames[position % UART_RECORD_FRAMES];
+        frame.us = us;
+        frame.direction = direction;
+        frame.size = min(size - done, (size_t)UART_RECORD_FRAME_BYTES);
+        memcpy(frame.bytes, bytes + done, frame.size);
+        head.store(++position, memory_order_release);
+    }
+}
+
+/** Open the file and start the background writer.
+@param fileName - session file
+@return - success
+*/
+bool UartRecorder::start(const string &fileName){
+    stop();
+    if ((file = fopen(fileName.c_str(), "wb")) == 0){
+        cerr << "Could not write " << fileName << endl;
+        return false;
+    }
+    fwrite(UART_RECORD_MAGIC, 1, 8, file);
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    recording = true;
+    flusher = thread(&UartRecorder::loop, this);
+    return true;
+}
+
+/** Write the rest and close the file.
+*/
+void UartRecorder::stop(){
+    if (!recording)
+        return;
+    {
+        lock_guard<mutex> guard(wakeLock);
+        recording = false;
+    }
+    wake.notify_one();
+    flusher.join();
+    flush();
+    fclose(file);
+    file = 0;
+    if (dropped > 0)
+        cerr << "UART recorder dropped " << dropped << " frames." << endl;
+}
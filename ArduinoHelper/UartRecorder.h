@@ -0,0 +1,86 @@
+#ifndef UARTRECORDER_H_INCLUDED
+#define UARTRECORDER_H_INCLUDED
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define UART_RECORD_FRAMES 8192 /// Frames in the preallocated ring
+#define UART_RECORD_FRAME_BYTES 16 /// Bytes in a frame. Longer transfers are split.
+
+/** Direction of a recorded transfer.
+*/
+enum UartDirection {UART_RX, UART_TX};
+
+/** One recorded transfer, or a part of it.
+*/
+struct UartFrame{
+    uint32_t us; /// Time, micros()
+    uint8_t direction; /// UartDirection
+    uint8_t size; /// Bytes used
+    uint8_t bytes[UART_RECORD_FRAME_BYTES]; /// Data
+};
+
+/** Records serial traffic in a binary session file. The serial port's thread only copies frames into a preallocated ring, a background thread
+writes them to the file. If the ring is full, frames are dropped and counted, the serial port never waits for the disk.
+File: "MRMSUART", then frames: time (4 bytes, little endian), direction (1), size (1), data (size).
+*/
+class UartRecorder{
+    public:
+        /** Constructor
+        */
+        UartRecorder();
+
+        /** Destructor, stops recording.
+        */
+        ~UartRecorder();
+
+        /** Read a session.
+        @param fileName - file
+        @param frames - frames read
+        @return - success
+        */
+        static bool read(const std::string &fileName, std::vector<UartFrame> &frames);
+
+        /** Record a transfer. Called by one thread only, the serial port's.
+        @param direction - received or sent
+        @param bytes - data
+        @param size - number of bytes
+        */
+        void record(UartDirection direction, const uint8_t *bytes, size_t size);
+
+        /** Open the file and start the background writer.
+        @param fileName - session file
+        @return - success
+        */
+        bool start(const std::string &fileName);
+
+        /** Write the rest and close the file.
+        */
+        void stop();
+
+    private:
+        uint32_t dropped = 0; /// Frames lost because the ring was full
+        FILE *file = 0; /// Session file
+        std::thread flusher; /// Background writer
+        std::vector<UartFrame> frames; /// Ring
+        std::atomic<uint32_t> head; /// Frames recorded so far
+        std::atomic<bool> recording; /// Background writer continues
+        std::atomic<uint32_t> tail; /// Frames written so far
+        std::condition_variable wake; /// Wakes the writer to stop
+        std::mutex wakeLock; /// For wake
+
+        /** Write recorded frames to the file.
+        */
+        void flush();
+
+        /** Background writer's loop.
+        */
+        void loop();
+};
+
+#endif // UARTRECORDER_H_INCLUDED
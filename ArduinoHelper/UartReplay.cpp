@@ -0,0 +1,84 @@
+#include "UartReplay.h"
+#include <fcntl.h>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wiringPi.h>
+
+using namespace std;
+
+/** Constructor
+*/
+UartReplay::UartReplay(){
+    done = false;
+}
+
+/** Destructor
+*/
+UartReplay::~UartReplay(){
+    if (writer.joinable())
+        writer.join();
+    if (master >= 0)
+        close(master);
+}
+
+/** Read a session and create the pseudo-terminal.
+@param fileName - session recorded by UartRecorder
+@return - success
+*/
+bool UartReplay::open(const string &fileName){
+    if (!UartRecorder::read(fileName, frames)){
+        cerr << "Could not read " << fileName << endl;
+        return false;
+    }
+    rxBytes = 0;
+    for (size_t i = 0; i < frames.size(); i++)
+        if (frames[i].direction == UART_RX)
+            rxBytes += frames[i].size;
+
+    if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master) != 0 || unlockpt(master) != 0){
+        perror("Pseudo-terminal error.");
+        return false;
+    }
+    slave = ptsname(master);
+    cout << fileName << ": " << frames.size() << " frames, " << rxBytes << " bytes received by RPI, replayed on " << slave << "." << endl;
+    return true;
+}
+
+/** Writer thread.
+@param realTime - recorded timing, otherwise as fast as possible.
+*/
+void UartReplay::play(bool realTime){
+    uint32_t startUs = micros();
+    for (size_t i = 0; i < frames.size(); i++){
+        const UartFrame &frame = frames[i];
+        if (frame.direction != UART_RX)
+            continue; /// RPI's own messages are produced by the replayed program.
+
+        if (realTime){
+            uint32_t dueUs = frame.us - frames[0].us;
+            uint32_t elapsedUs = micros() - startUs;
+            if (dueUs > elapsedUs)
+                delayMicroseconds(dueUs - elapsedUs);
+        }
+
+        for (uint8_t written = 0; written < frame.size;){
+            ssize_t count = ::write(master, frame.bytes + written, frame.size - written);
+            if (count <= 0){
+                perror("Replay error.");
+                done = true;
+                return;
+            }
+            written += count;
+        }
+    }
+    done = true;
+}
+
+/** Start playing, in a background thread. Open UART on device() first, so the terminal is already raw.
+@param realTime - recorded timing, otherwise as fast as possible.
+*/
+void UartReplay::start(bool realTime){
+    done = false;
+    writer = thread(&UartReplay::play, this, realTime);
+}
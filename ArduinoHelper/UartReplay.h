@@ -0,0 +1,62 @@
+#ifndef UARTREPLAY_H_INCLUDED
+#define UARTREPLAY_H_INCLUDED
+#include "UartRecorder.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Plays a recorded session's received bytes into a pseudo-terminal, so UART opened on its device gets them as if Arduino sent them. Either
+with recorded timing, to reproduce a run, or as fast as possible, to measure the parser's and dispatcher's throughput.
+*/
+class UartReplay{
+    public:
+        /** Constructor
+        */
+        UartReplay();
+
+        /** Destructor
+        */
+        ~UartReplay();
+
+        /** Bytes to be played.
+        @return - count
+        */
+        uint32_t bytes() const{ return rxBytes;}
+
+        /** Pseudo-terminal's device, for UART.
+        @return - path
+        */
+        const std::string &device() const{ return slave;}
+
+        /** All played.
+        @return - finished
+        */
+        bool finished() const{ return done;}
+
+        /** Read a session and create the pseudo-terminal.
+        @param fileName - session recorded by UartRecorder
+        @return - success
+        */
+        bool open(const std::string &fileName);
+
+        /** Start playing, in a background thread. Open UART on device() first, so the terminal is already raw.
+        @param realTime - recorded timing, otherwise as fast as possible.
+        */
+        void start(bool realTime);
+
+    private:
+        std::atomic<bool> done; /// All played
+        std::vector<UartFrame> frames; /// Session
+        int master = -1; /// Pseudo-terminal's master side
+        uint32_t rxBytes = 0; /// Received bytes in the session
+        std::string slave; /// Pseudo-terminal's device
+        std::thread writer; /// Plays the session
+
+        /** Writer thread.
+        @param realTime - recorded timing, otherwise as fast as possible.
+        */
+        void play(bool realTime);
+};
+
+#endif // UARTREPLAY_H_INCLUDED
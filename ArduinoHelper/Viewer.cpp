@@ -0,0 +1,170 @@
+#include "Viewer.h"
+#include <chrono>
+#include <opencv2/highgui/highgui.hpp>
+#include <set>
+
+using namespace std;
+using namespace cv;
+
+/** Constructor
+*/
+Viewer::Viewer(){
+    quit = false;
+    skippedCount = 0;
+    for (int i = 0; i < MAXIMUM_TRACKBARS; i++)
+        trackbarValues[i] = 0;
+}
+
+/** Destructor
+*/
+Viewer::~Viewer(){
+    stop();
+}
+
+/** Add a picture to the set being built. Call ready() first: the picture is copied only then.
+@param name - window's name
+@param image - picture
+@param x - window's position
+@param y - window's position
+@param overlay - primitives to be drawn on the picture.
+*/
+void Viewer::add(const string &name, const Mat &image, int x, int y, const Overlay &overlay){
+    Window window;
+    window.name = name;
+    image.copyTo(window.image);
+    window.overlay = overlay;
+    window.position = Point(x, y);
+    building.push_back(window);
+}
+
+/** Draw primitives on a picture.
+@param image - picture
+@param overlay - primitives
+*/
+void Viewer::draw(Mat &image, const Overlay &overlay){
+    if (image.channels() == 1)
+        cvtColor(image, image, COLOR_GRAY2BGR);
+    for (size_t i = 0; i < overlay.size(); i++){
+        const OverlayItem &item = overlay[i];
+        switch (item.type){
+            case OverlayItem::CIRCLE:
+                circle(image, item.position, item.radius, item.color, item.thickness, LINE_AA);
+                break;
+            case OverlayItem::POLYGON:
+                polylines(image, item.points, true, item.color, item.thickness, 8);
+                break;
+            case OverlayItem::TEXT:
+                putText(image, item.text, item.position, FONT_HERSHEY_COMPLEX_SMALL, 0.8, item.color, 0.6, CV_AA);
+                break;
+        }
+    }
+}
+
+/** Viewer thread's loop.
+*/
+void Viewer::loop(){
+    set<string> placed; /// Windows already moved to their positions
+
+    if (!trackbars.empty()){
+        namedWindow("Control", WINDOW_AUTOSIZE);
+        for (size_t i = 0; i < trackbars.size(); i++)
+            createTrackbar(trackbars[i].name, "Control", &trackbars[i].value, trackbars[i].maximum);
+    }
+
+    vector<Window> windows;
+    while (true){
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait_for(guard, chrono::milliseconds(30), [this]{ return !running || !pending.empty();});
+            if (!running)
+                break;
+            windows.swap(pending);
+            pending.clear();
+        }
+
+        for (size_t i = 0; i < windows.size(); i++){
+            draw(windows[i].image, windows[i].overlay);
+            imshow(windows[i].name, windows[i].image);
+            if (placed.insert(windows[i].name).second)
+                moveWindow(windows[i].name, windows[i].position.x, windows[i].position.y);
+        }
+        windows.clear();
+
+        /// HighGUI needs waitKey() to process events, also when there is nothing new.
+        uint8_t ch = waitKey(1);
+        if (ch == 'q' || ch == 27)//esc
+            quit = true;
+
+        /// A window closed by the user also ends the program.
+        for (set<string>::iterator it = placed.begin(); it != placed.end(); ++it)
+            if (getWindowProperty(*it, WND_PROP_VISIBLE) < 1)
+                quit = true;
+        if (!trackbars.empty() && getWindowProperty("Control", WND_PROP_VISIBLE) < 1)
+            quit = true;
+
+        for (size_t i = 0; i < trackbars.size(); i++)
+            trackbarValues[i] = trackbars[i].value;
+    }
+    destroyAllWindows();
+}
+
+/** Hand over the pictures added since the last call to the viewer thread.
+*/
+void Viewer::publish(){
+    {
+        lock_guard<mutex> guard(lock);
+        pending.swap(building);
+    }
+    building.clear();
+    changed.notify_one();
+}
+
+/** The viewer finished the previous set of pictures and a new one can be built. Otherwise the caller should skip this frame.
+@return - ready
+*/
+bool Viewer::ready(){
+    lock_guard<mutex> guard(lock);
+    if (!pending.empty()){
+        skippedCount++;
+        return false;
+    }
+    return true;
+}
+
+/** Start the viewer thread. Trackbars must be added before.
+*/
+void Viewer::start(){
+    lock_guard<mutex> guard(lock);
+    if (running)
+        return;
+    running = true;
+    viewerThread = thread(&Viewer::loop, this);
+}
+
+/** Stop the viewer thread.
+*/
+void Viewer::stop(){
+    {
+        lock_guard<mutex> guard(lock);
+        if (!running)
+            return;
+        running = false;
+    }
+    changed.notify_one();
+    viewerThread.join();
+}
+
+/** Add a trackbar to "Control" window. Must be called before start().
+@param name - trackbar's name
+@param value - initial value
+@param maximum - maximum value
+@return - index, for trackbar(), or -1 if too many.
+*/
+int Viewer::trackbarAdd(const string &name, int value, int maximum){
+    if (trackbars.size() == MAXIMUM_TRACKBARS)
+        return -1;
+    Trackbar trackbar = {name, value, maximum};
+    trackbars.push_back(trackbar);
+    trackbarValues[trackbars.size() - 1] = value;
+    return trackbars.size() - 1;
+}
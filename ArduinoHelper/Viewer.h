@@ -0,0 +1,116 @@
+#ifndef VIEWER_H_INCLUDED
+#define VIEWER_H_INCLUDED
+#include "Overlay.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MAXIMUM_TRACKBARS 8
+
+/** Displays pictures in its own thread, so the processing loop never waits for drawing or for a key. If the viewer is still busy with the
+previous pictures, new ones are skipped.
+*/
+class Viewer{
+    public:
+        /** Constructor
+        */
+        Viewer();
+
+        /** Destructor
+        */
+        ~Viewer();
+
+        /** Add a picture to the set being built. Call ready() first: the picture is copied only then.
+        @param name - window's name
+        @param image - picture
+        @param x - window's position
+        @param y - window's position
+        @param overlay - primitives to be drawn on the picture.
+        */
+        void add(const std::string &name, const Mat &image, int x, int y, const Overlay &overlay = Overlay());
+
+        /** Hand over the pictures added since the last call to the viewer thread.
+        */
+        void publish();
+
+        /** Key 'q' or Esc pressed in a window, or a window closed.
+        @return - quit requested
+        */
+        bool quitRequested(){ return quit;}
+
+        /** The viewer finished the previous set of pictures and a new one can be built. Otherwise the caller should skip this frame.
+        @return - ready
+        */
+        bool ready();
+
+        /** Number of sets skipped because the viewer was busy.
+        @return - count
+        */
+        uint32_t skipped(){ return skippedCount;}
+
+        /** Start the viewer thread. Trackbars must be added before.
+        */
+        void start();
+
+        /** Stop the viewer thread.
+        */
+        void stop();
+
+        /** Add a trackbar to "Control" window. Must be called before start().
+        @param name - trackbar's name
+        @param value - initial value
+        @param maximum - maximum value
+        @return - index, for trackbar(), or -1 if too many.
+        */
+        int trackbarAdd(const std::string &name, int value, int maximum);
+
+        /** Trackbar's current value.
+        @param index - returned by trackbarAdd()
+        @return - value
+        */
+        int trackbar(int index){ return trackbarValues[index];}
+
+    private:
+        /** A picture waiting to be displayed.
+        */
+        struct Window{
+            std::string name; /// Window's name
+            Mat image; /// Own copy
+            Overlay overlay; /// Primitives to draw
+            Point position; /// Window's position
+        };
+
+        /** A trackbar in "Control" window.
+        */
+        struct Trackbar{
+            std::string name; /// Trackbar's name
+            int value; /// Written by HighGUI in the viewer thread
+            int maximum; /// Maximum value
+        };
+
+        std::condition_variable changed; /// Signals new pictures or stop
+        std::mutex lock; /// Guards pending and running
+        std::vector<Window> building; /// Set being built by the processing thread
+        std::vector<Window> pending; /// Set waiting for the viewer thread
+        std::atomic<bool> quit; /// Key 'q' or Esc pressed, or a window closed
+        bool running = false; /// Thread should continue
+        std::atomic<uint32_t> skippedCount; /// Sets skipped because the viewer was busy
+        std::thread viewerThread; /// Viewer thread
+        std::vector<Trackbar> trackbars; /// Trackbars, used only by the viewer thread after start()
+        std::atomic<int> trackbarValues[MAXIMUM_TRACKBARS]; /// Trackbars' values, for the processing thread
+
+        /** Draw primitives on a picture.
+        @param image - picture
+        @param overlay - primitives
+        */
+        static void draw(Mat &image, const Overlay &overlay);
+
+        /** Viewer thread's loop.
+        */
+        void loop();
+};
+
+#endif // VIEWER_H_INCLUDED
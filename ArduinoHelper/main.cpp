@@ -6,16 +6,33 @@ Licence: You can use this code any way you like.
 */
 
 #include "Robot.h"
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
 
 ///Configuration
 const int thresh = 20; /// Canny algorithm threshold
 const bool saveImages = false; /// For tests later
+const CaptureFormat captureFormat = CAPTURE_BGR; /// CAPTURE_YUV420 skips color conversions in crossing detection
+const bool recordUart = false; /// Record UART traffic to UART_SESSION, for UART_REPLAY and UART_REPLAY_FAST
 Robot::State state = Robot::TEST_UART_MESSAGES; /// Check Robot::State to see all the options
 
 
 int main(int argc, char *argv[])
 {
-    Robot robot(state, thresh, saveImages); /// Object robot
+    /// Metrics of running instances: ArduinoHelper METRICS [state or ALL [period ms]], for example ArduinoHelper METRICS ALL 1000
+    if (argc > 1 && strcmp(argv[1], "METRICS") == 0)
+        return Robot::metricsShow(argc > 2 && strcmp(argv[2], "ALL") != 0 ? argv[2] : 0, argc > 3 ? atoi(argv[3]) : 0) ? 0 : 1;
+
+    /// State can be chosen in command line, for example: ArduinoHelper VISION_WORKER
+    if (argc > 1 && !Robot::stateFromName(argv[1], state)){
+        cerr << "Unknown state " << argv[1] << endl;
+        return 1;
+    }
+
+    Robot robot(state, thresh, saveImages, captureFormat); /// Object robot
+    if (recordUart)
+        robot.uartRecordSet(UART_SESSION);
     robot.run(); /// Start the program
     return 0;
 }